@@ -0,0 +1,241 @@
+/*
+ Schedtool
+ (c) by Freek <email_undisclosed>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation version 2 of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ Please see the file LICENSE for details.
+
+ */
+
+/*
+ Content:
+
+ core scheduling cookies (linux 5.14+, CONFIG_SCHED_CORE): only tasks
+ with the same cookie run on the SMT siblings of a core at the same time.
+ The prctl() interface can only create a cookie for a task, or copy one
+ from schedtool itself to a task (SHARE_TO) or from a task to schedtool
+ (SHARE_FROM) - so sharing always goes through our own cookie.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <sys/types.h>
+#include <sys/prctl.h>
+#include <unistd.h>
+
+#include "error.h"
+#include "coresched.h"
+
+/* constants are from include/uapi/linux/prctl.h for older headers */
+#ifndef PR_SCHED_CORE
+#define PR_SCHED_CORE			62
+#define PR_SCHED_CORE_GET		0
+#define PR_SCHED_CORE_CREATE		1
+#define PR_SCHED_CORE_SHARE_TO		2
+#define PR_SCHED_CORE_SHARE_FROM	3
+#define PR_SCHED_CORE_SCOPE_THREAD		0
+#define PR_SCHED_CORE_SCOPE_THREAD_GROUP	1
+#define PR_SCHED_CORE_SCOPE_PROCESS_GROUP	2
+#endif
+
+
+/* error.c knows EINVAL only for policies */
+static void core_error(char *fmt, pid_t pid)
+{
+	char msg[128];
+
+	snprintf(msg, sizeof(msg), fmt, pid);
+	if(errno == EINVAL) {
+		errno=0;
+		decode_error("%s - core scheduling not supported by this kernel", msg);
+	} else if(errno == ENODEV) {
+		errno=0;
+		decode_error("%s - no SMT, so nothing to isolate", msg);
+	} else {
+		decode_error("%s", msg);
+	}
+}
+
+
+/* -c new|group|share=PID|clear[,scope=thread|process|pgroup] */
+int coresched_opts(char *opts, struct coresched_s *c)
+{
+	char *tokens[] = { "new", "group", "share", "clear", "scope", NULL };
+	char *val, *end;
+
+	c->action=0;
+	c->scope=PR_SCHED_CORE_SCOPE_THREAD_GROUP;
+
+	while(*opts) {
+		switch(getsubopt(&opts, tokens, &val)) {
+		case 0:
+			c->action=CORE_NEW;
+			break;
+		case 1:
+			c->action=CORE_GROUP;
+			break;
+		case 2:
+			if(! val || (c->from=strtol(val, &end, 10)) <= 0 || *end) {
+				errno=0;
+				decode_error("share needs a PID to take the cookie from");
+				return(-1);
+			}
+			c->action=CORE_SHARE;
+			break;
+		case 3:
+			c->action=CORE_CLEAR;
+			break;
+		case 4:
+			if(val && ! strcmp(val, "thread")) {
+				c->scope=PR_SCHED_CORE_SCOPE_THREAD;
+			} else if(val && ! strcmp(val, "process")) {
+				c->scope=PR_SCHED_CORE_SCOPE_THREAD_GROUP;
+			} else if(val && ! strcmp(val, "pgroup")) {
+				c->scope=PR_SCHED_CORE_SCOPE_PROCESS_GROUP;
+			} else {
+				errno=0;
+				decode_error("scope must be thread, process or pgroup");
+				return(-1);
+			}
+			break;
+		default:
+			errno=0;
+			decode_error("unknown core scheduling option %s", val ? val : "");
+			return(-1);
+		}
+	}
+
+	if(! c->action) {
+		errno=0;
+		decode_error("-c needs one of new, group, share=PID or clear");
+		return(-1);
+	}
+	return(0);
+}
+
+
+int get_core_cookie(pid_t pid, unsigned long long *cookie)
+{
+	*cookie=0;
+	return(prctl(PR_SCHED_CORE, PR_SCHED_CORE_GET, pid,
+		     PR_SCHED_CORE_SCOPE_THREAD, (unsigned long)cookie));
+}
+
+
+/*
+ get our own cookie right before touching any PID: the one of c->from
+ to share it, none to clear
+ */
+int coresched_prepare(struct coresched_s *c)
+{
+	unsigned long long cookie;
+
+	if(c->action == CORE_SHARE) {
+		if(prctl(PR_SCHED_CORE, PR_SCHED_CORE_SHARE_FROM, c->from,
+			 PR_SCHED_CORE_SCOPE_THREAD, 0)) {
+			core_error("could not get core scheduling cookie of PID %d", c->from);
+			return(-1);
+		}
+
+	} else if(c->action == CORE_CLEAR) {
+		if(get_core_cookie(0, &cookie)) {
+			core_error("could not get core scheduling cookie of PID %d", getpid());
+			return(-1);
+		}
+		/* there's no way to drop a cookie but to share a null one */
+		if(cookie) {
+			errno=0;
+			decode_error("schedtool runs with a core scheduling cookie itself, can't clear");
+			return(-1);
+		}
+	}
+	return(0);
+}
+
+
+int set_core_cookie(pid_t pid, struct coresched_s *c)
+{
+	int ret;
+
+	/* the first PID of a group gets the cookie everybody else copies */
+	if(c->action == CORE_NEW || (c->action == CORE_GROUP && ! c->have_cookie)) {
+		if((ret=prctl(PR_SCHED_CORE, PR_SCHED_CORE_CREATE, pid, c->scope, 0))) {
+			core_error("could not create core scheduling cookie for PID %d", pid);
+			return(ret);
+		}
+		if(c->action == CORE_GROUP) {
+			if((ret=prctl(PR_SCHED_CORE, PR_SCHED_CORE_SHARE_FROM, pid,
+				      PR_SCHED_CORE_SCOPE_THREAD, 0))) {
+				core_error("could not get core scheduling cookie of PID %d", pid);
+				return(ret);
+			}
+			c->have_cookie=1;
+		}
+		return(0);
+	}
+
+	if((ret=prctl(PR_SCHED_CORE, PR_SCHED_CORE_SHARE_TO, pid, c->scope, 0))) {
+		core_error((c->action == CORE_CLEAR ? "could not clear core scheduling cookie of PID %d"
+			    : "could not share core scheduling cookie with PID %d"), pid);
+		return(ret);
+	}
+	return(0);
+}
+
+
+static int cmp_cookie(const void *a, const void *b)
+{
+	const unsigned long long *x=a, *y=b;
+
+	/* cookie first, PID second */
+	if(x[0] != y[0]) {
+		return(x[0] < y[0] ? -1 : 1);
+	}
+	return(x[1] < y[1] ? -1 : (x[1] > y[1]));
+}
+
+
+/* list the PIDs which share a cookie, e.g. "COOKIE 0x...: PIDs 1 2 3" */
+void print_cookie_groups(pid_t *pids, int n)
+{
+	/* pairs of cookie, PID */
+	unsigned long long (*c)[2];
+	int i, j, m=0;
+
+	if(n < 2 || ! (c=calloc(n, sizeof(*c)))) {
+		return;
+	}
+
+	for(i=0; i < n; i++) {
+		if(! get_core_cookie(pids[i], &(c[m][0])) && c[m][0]) {
+			c[m++][1]=pids[i];
+		}
+	}
+	qsort(c, m, sizeof(*c), cmp_cookie);
+
+	for(i=0; i < m; i=j) {
+		for(j=i+1; j < m && c[j][0] == c[i][0]; j++)
+			;
+		if(j - i < 2) {
+			continue;
+		}
+		printf("COOKIE 0x%llx shared by PIDs", c[i][0]);
+		for(; i < j; i++) {
+			printf(" %llu", c[i][1]);
+		}
+		printf("\n");
+	}
+	free(c);
+}
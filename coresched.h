@@ -0,0 +1,38 @@
+/*
+ Schedtool
+ (c) by Freek <email_undisclosed>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation version 2 of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ Please see the file LICENSE for details.
+
+ */
+
+/* what -c does to each PID */
+#define CORE_NEW	1	/* a new cookie of its own */
+#define CORE_GROUP	2	/* one new cookie shared by all PIDs */
+#define CORE_SHARE	3	/* the cookie of another PID */
+#define CORE_CLEAR	4	/* no cookie, may share a core with anyone */
+
+struct coresched_s {
+	int action;
+	/* PR_SCHED_CORE_SCOPE_* */
+	int scope;
+	/* CORE_SHARE: where to take the cookie from */
+	pid_t from;
+	/* CORE_GROUP: schedtool holds the group's cookie already */
+	int have_cookie;
+};
+
+int coresched_opts(char *opts, struct coresched_s *c);
+int coresched_prepare(struct coresched_s *c);
+int set_core_cookie(pid_t pid, struct coresched_s *c);
+int get_core_cookie(pid_t pid, unsigned long long *cookie);
+void print_cookie_groups(pid_t *pids, int n);
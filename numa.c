@@ -0,0 +1,179 @@
+/*
+ Schedtool
+ (c) by Freek <email_undisclosed>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation version 2 of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ Please see the file LICENSE for details.
+
+ */
+
+/*
+ Content:
+
+ memory-following placement: find the NUMA node holding most of a PID's
+ resident pages (from /proc/PID/numa_maps) and the CPUs of that node
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sched.h>
+
+#include "error.h"
+#include "topology.h"
+#include "numa.h"
+#include "taskstat.h"
+
+
+/*
+ sum up the N<node>=<pages> fields of all mappings, weighted by page size;
+ returns 0 on success, 1 if nothing is resident (kernel threads), -1 on error
+ */
+int numa_placement(pid_t pid, struct numa_info_s *info)
+{
+	FILE *f;
+	char path[64];
+	char *buf=NULL;
+	size_t len=0;
+	static long kb[NUMA_MAX_NODES];
+	int node, n_nodes=0;
+
+	memset(info, 0, sizeof(*info));
+	memset(kb, 0, sizeof(kb));
+	info->node=-1;
+
+	snprintf(path, sizeof(path), "/proc/%d/numa_maps", pid);
+	if(! (f=fopen(path, "r"))) {
+		decode_error("could not read memory placement of PID %d", pid);
+		return(-1);
+	}
+
+	while(getline(&buf, &len, f) != -1) {
+		/* kernelpagesize_kB comes after the N<node>= fields */
+		long pages=0, page_kb=4;
+		char *tok, *line=buf;
+		int i, n=0;
+		struct {
+			int node;
+			long pages;
+		} per_node[64];
+
+		while((tok=strsep(&line, " \n"))) {
+			if(sscanf(tok, "N%d=%ld", &node, &pages) == 2) {
+				if(node >= 0 && node < NUMA_MAX_NODES
+				   && n < (int)(sizeof(per_node) / sizeof(*per_node))) {
+					per_node[n].node=node;
+					per_node[n++].pages=pages;
+				}
+			} else {
+				sscanf(tok, "kernelpagesize_kB=%ld", &page_kb);
+			}
+		}
+
+		for(i=0; i < n; i++) {
+			kb[per_node[i].node] += per_node[i].pages * page_kb;
+			if(per_node[i].node >= n_nodes) {
+				n_nodes=per_node[i].node + 1;
+			}
+		}
+	}
+	free(buf);
+	fclose(f);
+
+	for(node=0; node < n_nodes; node++) {
+		info->kb_total += kb[node];
+		if(kb[node] > info->kb_node) {
+			info->kb_node=kb[node];
+			info->node=node;
+		}
+	}
+
+	if(info->node < 0) {
+		return(1);
+	}
+
+	snprintf(path, sizeof(path), SYSFS_NODE "/node%d/cpulist", info->node);
+	if(read_cpulist(path, &(info->cpus)) || ! CPU_COUNT(&(info->cpus))) {
+		/* memory-only node, e.g. CXL or HBM; nothing to follow */
+		errno=0;
+		decode_error("node %d of PID %d has no CPUs", info->node, pid);
+		return(-1);
+	}
+	return(0);
+}
+
+
+void print_numa_header(void)
+{
+	printf("%-7s %-16s %4s %5s %10s  %-16s %-16s %s\n",
+	       "PID", "COMM", "NODE", "ON%", "RSS_KB", "AFFINITY", "NODE_CPUS", "STATE");
+}
+
+
+/*
+ one line of the placement table; AFFINITY covers all threads:
+	ok	may only run on the node holding its memory
+	spread	may run there, but on other nodes, too
+	remote	may not run on the node holding its memory at all
+	nomem	nothing resident, nothing to follow
+ */
+void print_numa(pid_t pid, struct numa_info_s *info)
+{
+	cpu_set_t aff_mask, tmp;
+	char comm[32], aff_list[CPU_SETSIZE * 4], node_list[CPU_SETSIZE * 4];
+	char *state;
+	pid_t *tids;
+	int i, n;
+
+	get_comm(pid, pid, comm, sizeof(comm));
+
+	if(info->node < 0) {
+		printf("%-7d %-16s %4s %5s %10s  %-16s %-16s %s\n",
+		       pid, comm, "-", "-", "0", "-", "-", "nomem");
+		return;
+	}
+
+	/* where any of its threads may run */
+	CPU_ZERO(&aff_mask);
+	if((n=get_threads(pid, &tids)) > 0) {
+		for(i=0; i < n; i++) {
+			if(sched_getaffinity(tids[i], sizeof(tmp), &tmp) != -1) {
+				CPU_OR(&aff_mask, &aff_mask, &tmp);
+			}
+		}
+		free(tids);
+	} else if(sched_getaffinity(pid, sizeof(aff_mask), &aff_mask) == -1) {
+		CPU_ZERO(&aff_mask);
+	}
+
+	CPU_AND(&tmp, &aff_mask, &(info->cpus));
+	if(! CPU_COUNT(&tmp)) {
+		state="remote";
+	} else if(CPU_EQUAL(&tmp, &aff_mask)) {
+		state="ok";
+	} else {
+		state="spread";
+	}
+
+	printf("%-7d %-16s %4d %5.1f %10ld  %-16s %-16s %s\n",
+	       pid,
+	       comm,
+	       info->node,
+	       info->kb_total ? 100.0 * info->kb_node / info->kb_total : 0.0,
+	       info->kb_total,
+	       cpuset_to_cpulist(&aff_mask, aff_list, sizeof(aff_list)),
+	       cpuset_to_cpulist(&(info->cpus), node_list, sizeof(node_list)),
+	       state
+	      );
+}
@@ -0,0 +1,33 @@
+/*
+ Schedtool
+ (c) by Freek <email_undisclosed>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation version 2 of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ Please see the file LICENSE for details.
+
+ */
+
+#define SYSFS_NODE	"/sys/devices/system/node"
+#define NUMA_MAX_NODES	1024
+
+/* where the resident memory of a PID sits */
+struct numa_info_s {
+	/* node holding most of it, -1 if nothing is resident */
+	int node;
+	long kb_total;
+	long kb_node;
+	/* CPUs of node */
+	cpu_set_t cpus;
+};
+
+int numa_placement(pid_t pid, struct numa_info_s *info);
+void print_numa_header(void);
+void print_numa(pid_t pid, struct numa_info_s *info);
@@ -0,0 +1,232 @@
+/*
+ Schedtool
+ (c) by Freek <email_undisclosed>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation version 2 of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ Please see the file LICENSE for details.
+
+ */
+
+/*
+ Content:
+
+ parsing and formatting of command line and profile values: integers,
+ hex affinity masks and affinity lists
+ kept apart from schedtool.c so tests/ can link it
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <sched.h>
+
+#include "error.h"
+#include "topology.h"
+#include "parse.h"
+
+
+/* the whole string has to be a number, unlike atoi() */
+int parse_int(const char *str, int *val)
+{
+	char *end;
+	long l;
+
+	errno=0;
+	l=strtol(str, &end, 10);
+	if(errno || end == str || *end || l < INT_MIN || l > INT_MAX) {
+		errno=0;
+		return(-1);
+	}
+	*val=(int)l;
+	return(0);
+}
+
+
+/* only digits, so -1 (all processes for kill()) can't sneak in */
+int parse_pid(const char *str, pid_t *pid)
+{
+	int val;
+
+	if(! isdigit((unsigned char)*str) || parse_int(str, &val)) {
+		return(-1);
+	}
+	*pid=val;
+	return(0);
+}
+
+
+/*
+ the following functions have been taken from taskset of util-linux
+ (C) 2004 by Robert Love
+ */
+static inline int val_to_char(int v)
+{
+	if (v >= 0 && v < 10)
+		return '0' + v;
+	else if (v >= 10 && v < 16)
+		return ('a' - 10) + v;
+	else 
+		return -1;
+}
+
+
+/*
+ str seems to need to hold [CPU_SETSIZE * 7] chars, as in used in taskset
+ however, 4 bits of CPU_SETSIZE will naturally reduce to 1 char
+ (bits "1111" -> char "f") so CPU_SETSIZE / 4 + 1 should be sufficient
+
+ will pad with zeroes to the start, so print the string starting at the
+ returned char *
+ */
+char * cpuset_to_str(cpu_set_t *mask, char *str)
+{
+	int base;
+	char *ptr = str;
+	char *ret = 0;
+
+	for (base = CPU_SETSIZE - 4; base >= 0; base -= 4) {
+		char val = 0;
+		if (CPU_ISSET(base, mask))
+			val |= 1;
+		if (CPU_ISSET(base + 1, mask))
+			val |= 2;
+		if (CPU_ISSET(base + 2, mask))
+			val |= 4;
+		if (CPU_ISSET(base + 3, mask))
+			val |= 8;
+		if (!ret && val)
+			ret = ptr;
+		*ptr++ = val_to_char(val);
+	}
+	*ptr = 0;
+	return ret ? ret : ptr - 1;
+}
+
+
+static inline int char_to_val(int c)
+{
+	int cl;
+
+	cl = tolower(c);
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	else if (cl >= 'a' && cl <= 'f')
+		return cl + (10 - 'a');
+	else
+		return -1;
+}
+
+
+/*
+ "0x" is optional; digits beyond CPU_SETSIZE bits have to be zero
+ */
+int str_to_cpuset(cpu_set_t *mask, const char* str)
+{
+	const char *ptr;
+	int base = 0;
+
+	/* skip 0x, it's all hex anyway */
+	if(str[0] == '0' && (str[1] == 'x' || str[1] == 'X')) {
+		str += 2;
+	}
+	if(! *str) {
+		return -1;
+	}
+	ptr = str + strlen(str) - 1;
+
+	CPU_ZERO(mask);
+	while (ptr >= str) {
+		char val = char_to_val((unsigned char)*ptr);
+		if (val == (char) -1)
+			return -1;
+		if (val && base >= CPU_SETSIZE)
+			return -1;
+		if (val & 1)
+			CPU_SET(base, mask);
+		if (val & 2)
+			CPU_SET(base + 1, mask);
+		if (val & 4)
+			CPU_SET(base + 2, mask);
+		if (val & 8)
+			CPU_SET(base + 3, mask);
+		ptr--;
+		base += 4;
+	}
+
+	return 0;
+}
+/* end of functions taken */
+
+
+/*
+ mhm - we need something clever for all that CPU_SET() and CPU_ISSET() stuff
+ list mode elements are CPUs, ranges of CPUs or tokens from cpu_token()
+ */
+int parse_affinity(cpu_set_t *mask, const char *arg)
+{
+	cpu_set_t tmp_aff, tmp_elem;
+	char *tmp_arg, *list, *copy;
+
+        CPU_ZERO(&tmp_aff);
+
+	if(*arg == '0' && (*(arg+1) == 'x' || *(arg+1) == 'X')) {
+		/* we're in standard hex mode */
+		if(str_to_cpuset(&tmp_aff, arg)) {
+			errno=0;
+			decode_error("affinity %s is not a hex mask", arg);
+			return(-1);
+		}
+
+	} else {
+		/* list mode: schedtool -a 0,2 -> run on CPU0 and CPU2 */
+
+		/* strsep() cuts it up, but arg is needed for errors */
+		if(! (list=copy=strdup(arg))) {
+			decode_error("could not parse affinity %s", arg);
+			return(-1);
+		}
+
+		/* split on ',' and '.', because '.' is near ',' :) */
+		while((tmp_arg=strsep(&list, ",."))) {
+
+			if(! *tmp_arg) {
+				continue;
+			}
+
+			/* 3 or 4-7, or a token like isolated */
+			if(isdigit((int)*tmp_arg) ? parse_cpulist(tmp_arg, &tmp_elem)
+			   : cpu_token(tmp_arg, &tmp_elem)) {
+				decode_error("affinity %s is not parseable", tmp_arg);
+				free(copy);
+				return(-1);
+			}
+#ifdef DEBUG
+			printf("tmp_arg: %s -> %d CPUs\n", tmp_arg, CPU_COUNT(&tmp_elem));
+#endif
+			CPU_OR(&tmp_aff, &tmp_aff, &tmp_elem);
+		}
+		free(copy);
+	}
+
+	if(! CPU_COUNT(&tmp_aff)) {
+		errno=0;
+		decode_error("affinity %s results in no CPUs", arg);
+		return(-1);
+	}
+
+        *mask=tmp_aff;
+	return 0;
+}
@@ -0,0 +1,29 @@
+/*
+ Schedtool
+ (c) by Freek <email_undisclosed>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation version 2 of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ Please see the file LICENSE for details.
+
+ */
+
+/*
+ 4 bits of CPU_SETSIZE will naturally reduce to 1 char, so
+ we'd only need [CPU_SETSIZE / 4 + 1]
+ to be sure leave a bit of room and only do CPU_SETSIZE / 2
+ */
+#define CPUSET_HEXSTRING(name) char name[CPU_SETSIZE / 2]
+
+int parse_int(const char *str, int *val);
+int parse_pid(const char *str, pid_t *pid);
+int str_to_cpuset(cpu_set_t *mask, const char *str);
+char * cpuset_to_str(cpu_set_t *mask, char *str);
+int parse_affinity(cpu_set_t *mask, const char *arg);
@@ -0,0 +1,471 @@
+/*
+ Schedtool
+ (c) by Freek <email_undisclosed>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation version 2 of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ Please see the file LICENSE for details.
+
+ */
+
+/*
+ Content:
+
+ named tuning profiles, read from PROFILE_SYSTEM_FILE and the user's
+ PROFILE_USER_FILE. The format is ini-like:
+
+	# comment
+	[audio]
+	policy = R
+	prio = 70
+	nice = -5
+	affinity = 2,3
+
+	[audio-low]
+	inherit = audio
+	nice = 0
+
+	[ui]
+	policy = N
+	slice = 500
+
+ A profile in the user's file replaces one of the same name in the system
+ file. All profiles are parsed and validated once, before anything is set.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <sched.h>
+
+#include "error.h"
+#include "schedtool.h"
+#include "profile.h"
+#include "parse.h"
+
+static struct profile_s *profiles;
+static int n_profiles;
+static int profiles_loaded;
+
+/* accepted spellings for policy=, optionally prefixed by SCHED_ */
+static struct {
+	char *name;
+	int policy;
+} policy_names[] = {
+	{ "N",		SCHED_NORMAL },
+	{ "NORMAL",	SCHED_NORMAL },
+	{ "OTHER",	SCHED_NORMAL },
+	{ "F",		SCHED_FIFO },
+	{ "FIFO",	SCHED_FIFO },
+	{ "R",		SCHED_RR },
+	{ "RR",		SCHED_RR },
+	{ "B",		SCHED_BATCH },
+	{ "BATCH",	SCHED_BATCH },
+	{ "I",		SCHED_ISO },
+	{ "ISO",	SCHED_ISO },
+	{ "D",		SCHED_IDLEPRIO },
+	{ "IDLEPRIO",	SCHED_IDLEPRIO },
+	{ 0, 0 }
+};
+
+
+/*
+ decode_error() appends strerror(errno), which is meaningless for syntax
+ errors; file may be NULL for profiles combined on the command line
+ */
+#define profile_error(file, line, ...) do { \
+		errno=0; \
+		if(file) { \
+			printf("%s:%d: ", (char *)file, line); \
+		} \
+		decode_error(__VA_ARGS__); \
+	} while(0)
+
+
+static char * strip(char *str)
+{
+	char *end;
+
+	while(isspace((int)*str)) {
+		str++;
+	}
+	end=str + strlen(str);
+	while(end > str && isspace((int)*(end-1))) {
+		*--end=0;
+	}
+	return str;
+}
+
+
+static int parse_policy(char *str, int *policy)
+{
+	int i;
+
+	if(! strncasecmp(str, "SCHED_", 6)) {
+		str += 6;
+	}
+
+	for(i=0; policy_names[i].name; i++) {
+		if(! strcasecmp(str, policy_names[i].name)) {
+			*policy=policy_names[i].policy;
+			return(0);
+		}
+	}
+
+	/* raw number, like -M */
+	return(parse_int(str, policy));
+}
+
+
+static struct profile_s * find_profile(char *name)
+{
+	int i;
+
+	/* the last definition wins, so the user's file overrides the system's */
+	for(i=n_profiles-1; i >= 0; i--) {
+		if(! strcmp(profiles[i].name, name)) {
+			return(&profiles[i]);
+		}
+	}
+	return(NULL);
+}
+
+
+/* copy everything set in src over dst */
+static void merge_profile(struct profile_s *dst, struct profile_s *src)
+{
+	if(src->set & PROFILE_POLICY) {
+		dst->policy=src->policy;
+	}
+	if(src->set & PROFILE_PRIO) {
+		dst->prio=src->prio;
+	}
+	if(src->set & PROFILE_NICE) {
+		dst->nice=src->nice;
+	}
+	if(src->set & PROFILE_AFFINITY) {
+		dst->aff_mask=src->aff_mask;
+	}
+	if(src->set & PROFILE_SLICE) {
+		dst->slice=src->slice;
+	}
+	dst->set |= src->set;
+}
+
+
+static int set_key(struct profile_s *p, char *key, char *val, char *file, int line)
+{
+	if(! strcmp(key, "inherit")) {
+		if(strlen(val) >= PROFILE_NAME_LEN) {
+			profile_error(file, line, "profile name %s is too long", val);
+			return(-1);
+		}
+		strcpy(p->inherit, val);
+
+	} else if(! strcmp(key, "policy")) {
+		if(parse_policy(val, &(p->policy))) {
+			profile_error(file, line, "unknown policy %s", val);
+			return(-1);
+		}
+		p->set |= PROFILE_POLICY;
+
+	} else if(! strcmp(key, "prio") || ! strcmp(key, "priority")) {
+		if(parse_int(val, &(p->prio))) {
+			profile_error(file, line, "PRIO %s is not a number", val);
+			return(-1);
+		}
+		p->set |= PROFILE_PRIO;
+
+	} else if(! strcmp(key, "nice")) {
+		if(parse_int(val, &(p->nice))) {
+			profile_error(file, line, "NICE %s is not a number", val);
+			return(-1);
+		}
+		if(! CHECK_RANGE_NICE(p->nice)) {
+			profile_error(file, line, "NICE %d is out of range -20 to 20", p->nice);
+			return(-1);
+		}
+		p->set |= PROFILE_NICE;
+
+	} else if(! strcmp(key, "affinity")) {
+		if(parse_affinity(&(p->aff_mask), val)) {
+			profile_error(file, line, "invalid affinity in profile %s", p->name);
+			return(-1);
+		}
+		p->set |= PROFILE_AFFINITY;
+
+	} else if(! strcmp(key, "slice")) {
+		if(parse_int(val, &(p->slice))) {
+			profile_error(file, line, "SLICE %s is not a number", val);
+			return(-1);
+		}
+		if(! CHECK_RANGE_SLICE(p->slice)) {
+			profile_error(file, line, "SLICE %d is out of range %d-%d us",
+				      p->slice, SLICE_MIN, SLICE_MAX);
+			return(-1);
+		}
+		p->set |= PROFILE_SLICE;
+
+	} else {
+		profile_error(file, line, "unknown key %s", key);
+		return(-1);
+	}
+	return(0);
+}
+
+
+/* returns the # of errors found in file; a missing file is no error */
+static int read_profile_file(char *file)
+{
+	FILE *f;
+	char *buf=NULL;
+	size_t len=0;
+	int line=0, errors=0;
+	/* index of the section we're in, -1 before the first one */
+	int cur=-1, first=n_profiles;
+
+	if(! (f=fopen(file, "r"))) {
+		return(0);
+	}
+	file=strdup(file);
+
+	while(getline(&buf, &len, f) != -1) {
+		char *str, *val;
+
+		line++;
+
+		if((str=strchr(buf, '#'))) {
+			*str=0;
+		}
+		str=strip(buf);
+		if(! *str) {
+			continue;
+		}
+
+		if(*str == '[') {
+			struct profile_s *p;
+			char *end=str + strlen(str) - 1;
+			int i;
+
+			str=strip(str+1);
+			if(*end != ']') {
+				profile_error(file, line, "missing ] after profile name");
+				errors++;
+				cur=-1;
+				continue;
+			}
+			*end=0;
+			str=strip(str);
+
+			if(! *str || strlen(str) >= PROFILE_NAME_LEN
+			   || strspn(str, "abcdefghijklmnopqrstuvwxyz"
+				     "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_.-") != strlen(str)) {
+				profile_error(file, line, "invalid profile name [%s]", str);
+				errors++;
+				cur=-1;
+				continue;
+			}
+
+			/* within one file, names have to be unique */
+			for(i=first; i < n_profiles; i++) {
+				if(! strcmp(profiles[i].name, str)) {
+					profile_error(file, line, "profile %s already defined at line %d",
+						      str, profiles[i].line);
+					errors++;
+					break;
+				}
+			}
+
+			if(! (p=realloc(profiles, (n_profiles + 1) * sizeof(*profiles)))) {
+				decode_error("could not allocate profile %s", str);
+				errors++;
+				break;
+			}
+			profiles=p;
+			cur=n_profiles++;
+			p=&profiles[cur];
+
+			memset(p, 0, sizeof(*p));
+			strcpy(p->name, str);
+			p->file=file;
+			p->line=line;
+			continue;
+		}
+
+		if(! (val=strchr(str, '='))) {
+			profile_error(file, line, "expected key = value");
+			errors++;
+			continue;
+		}
+		*val++=0;
+		str=strip(str);
+		val=strip(val);
+
+		if(cur < 0) {
+			profile_error(file, line, "%s outside of a [profile]", str);
+			errors++;
+			continue;
+		}
+
+		if(set_key(&profiles[cur], str, val, file, line)) {
+			errors++;
+		}
+	}
+
+	free(buf);
+	fclose(f);
+	return(errors);
+}
+
+
+/* merge name and everything it inherits from into result */
+static int resolve_one(char *name, struct profile_s *result, int depth)
+{
+	struct profile_s *p;
+
+	if(! (p=find_profile(name))) {
+		errno=0;
+		decode_error("unknown profile %s", name);
+		return(-1);
+	}
+
+	if(depth > n_profiles) {
+		profile_error(p->file, p->line, "inheritance loop at profile %s", name);
+		return(-1);
+	}
+
+	if(*(p->inherit) && resolve_one(p->inherit, result, depth+1)) {
+		return(-1);
+	}
+
+	merge_profile(result, p);
+	return(0);
+}
+
+
+/* checks which need more than one key, e.g. priority range of the policy */
+static int validate_profile(struct profile_s *p, char *file, int line)
+{
+	int prio_min, prio_max;
+
+	if(! (p->set & PROFILE_POLICY)) {
+		/* only usable together with other profiles or options */
+		return(0);
+	}
+
+	if((p->set & PROFILE_SLICE) && ! IS_FAIR_POLICY(p->policy)) {
+		profile_error(file, line, "slice only applies to SCHED_NORMAL and SCHED_BATCH");
+		return(-1);
+	}
+
+	if(p->policy == SCHED_NORMAL || p->policy == SCHED_BATCH
+	   || p->policy == SCHED_IDLEPRIO) {
+		if((p->set & PROFILE_PRIO) && p->prio) {
+			profile_error(file, line, "static PRIO must be 0 or omitted for %s",
+				      TAB[p->policy]);
+			return(-1);
+		}
+
+	} else if(p->policy == SCHED_FIFO || p->policy == SCHED_RR
+		  || p->policy == SCHED_ISO) {
+
+		get_prio_min_max(p->policy, &prio_min, &prio_max);
+
+		if((prio_min|prio_max) == -1) {
+			profile_error(file, line, "%s not implemented by this kernel",
+				      TAB[p->policy]);
+			return(-1);
+		}
+		if(! (p->set & PROFILE_PRIO)) {
+			profile_error(file, line, "missing prio for %s", TAB[p->policy]);
+			return(-1);
+		}
+		if(! CHECK_RANGE_PRIO(p->prio, prio_min, prio_max)) {
+			profile_error(file, line, "PRIO %d is out of range %d-%d for %s",
+				      p->prio, prio_min, prio_max, TAB[p->policy]);
+			return(-1);
+		}
+	}
+	return(0);
+}
+
+
+/* read and validate all profiles; done once, any error is fatal */
+static int load_profiles(void)
+{
+	char *home, *user=NULL;
+	int i, errors=0;
+
+	profiles_loaded=1;
+
+	errors += read_profile_file(PROFILE_SYSTEM_FILE);
+
+	if((user=getenv(PROFILE_ENV))) {
+		errors += read_profile_file(user);
+	} else if((home=getenv("HOME"))
+		  && asprintf(&user, "%s/" PROFILE_USER_FILE, home) != -1) {
+		errors += read_profile_file(user);
+		free(user);
+	}
+
+	/* only check what will actually be used */
+	for(i=0; i < n_profiles; i++) {
+		struct profile_s resolved;
+
+		if(find_profile(profiles[i].name) != &profiles[i]) {
+			continue;
+		}
+
+		memset(&resolved, 0, sizeof(resolved));
+		if(resolve_one(profiles[i].name, &resolved, 0)
+		   || validate_profile(&resolved, profiles[i].file, profiles[i].line)) {
+			errors++;
+		}
+	}
+
+	if(errors) {
+		errno=0;
+		decode_error("%d error(s) in profiles - not applying any", errors);
+		return(-1);
+	}
+	return(0);
+}
+
+
+/*
+ merge the comma-separated list of profiles into result, left to right,
+ so later ones override earlier ones
+ */
+int resolve_profiles(char *names, struct profile_s *result)
+{
+	char *name;
+
+	if(! profiles_loaded && load_profiles()) {
+		return(-1);
+	}
+
+	while((name=strsep(&names, ","))) {
+		name=strip(name);
+		if(! *name) {
+			continue;
+		}
+		if(resolve_one(name, result, 0)) {
+			return(-1);
+		}
+	}
+
+	if(validate_profile(result, NULL, 0)) {
+		return(-1);
+	}
+	return(0);
+}
@@ -0,0 +1,50 @@
+/*
+ Schedtool
+ (c) by Freek <email_undisclosed>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation version 2 of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ Please see the file LICENSE for details.
+
+ */
+
+/* system-wide profiles, then the user's in $HOME (or $SCHEDTOOL_CONF) */
+#define PROFILE_SYSTEM_FILE	"/etc/schedtool.conf"
+#define PROFILE_USER_FILE	".schedtool.conf"
+#define PROFILE_ENV		"SCHEDTOOL_CONF"
+
+#define PROFILE_NAME_LEN	64
+
+/* which fields of a profile have been given */
+#define PROFILE_POLICY		0x1
+#define PROFILE_PRIO		0x2
+#define PROFILE_NICE		0x4
+#define PROFILE_AFFINITY	0x8
+#define PROFILE_SLICE		0x10
+
+struct profile_s {
+	char name[PROFILE_NAME_LEN];
+	/* profile this one is based on, "" for none */
+	char inherit[PROFILE_NAME_LEN];
+
+	int set;
+	int policy;
+	int prio;
+	int nice;
+	cpu_set_t aff_mask;
+	/* in us */
+	int slice;
+
+	/* where it was defined, for error messages */
+	char *file;
+	int line;
+};
+
+int resolve_profiles(char *names, struct profile_s *result);
@@ -0,0 +1,409 @@
+/*
+ Schedtool
+ (c) by Freek <email_undisclosed>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation version 2 of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ Please see the file LICENSE for details.
+
+ */
+
+/*
+ Content:
+
+ userspace rebalancer for pinned threads. The kernel can't balance
+ threads pinned to a single CPU, so every interval we
+ - sample runtime and run delay of all threads of the given PIDs
+ - sample the utilization of each CPU
+ - move threads off the CPU with the biggest run delay onto the least
+   utilized one, if that doesn't just turn the imbalance around
+
+ Only threads pinned to exactly one CPU of the allowed set are touched.
+ A moved thread stays put for a few intervals to avoid ping-ponging.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <sys/types.h>
+#include <sched.h>
+
+#include "error.h"
+#include "schedtool.h"
+#include "topology.h"
+#include "taskstat.h"
+#include "rebalance.h"
+
+/* per-mille of one CPU */
+#define PERMILLE	1000
+
+struct rb_thread_s {
+	pid_t pid;
+	pid_t tid;
+	/* the CPU it's pinned to */
+	int cpu;
+	struct schedstat_s stat;
+	/* within the last interval, in ns */
+	unsigned long long d_run;
+	unsigned long long d_wait;
+	/* only seen once, no deltas yet */
+	int fresh;
+	/* intervals to wait until it may be moved again */
+	int hold;
+};
+
+/*
+ -b [MS][,interval=MS][,moves=N][,hold=N][,threshold=US][,count=N]
+ a bare number is the interval
+ */
+int rebalance_opts(char *opts, struct rebalance_s *r)
+{
+	char *tokens[] = { "interval", "moves", "hold", "threshold", "count", NULL };
+	char *val, *end;
+	long l;
+	int i;
+
+	r->interval=1000;
+	r->moves=1;
+	r->hold=5;
+	r->threshold=1000;
+	r->count=0;
+
+	while(*opts) {
+		if((i=getsubopt(&opts, tokens, &val)) < 0 && val && isdigit((int)*val)) {
+			i=0;
+		} else if(i < 0 || ! val) {
+			errno=0;
+			decode_error("unknown or incomplete rebalancer option %s", val ? val : "");
+			return(-1);
+		}
+
+		l=strtol(val, &end, 10);
+		if(end == val || *end || l < 0 || (i == 0 && l == 0)) {
+			errno=0;
+			decode_error("invalid value %s for %s", val, tokens[i]);
+			return(-1);
+		}
+
+		switch(i) {
+		case 0: r->interval=l; break;
+		case 1: r->moves=l; break;
+		case 2: r->hold=l; break;
+		case 3: r->threshold=l; break;
+		case 4: r->count=l; break;
+		}
+	}
+	return(0);
+}
+
+
+static struct rb_thread_s * find_thread(struct rb_thread_s *t, int n, pid_t tid)
+{
+	int lo=0, hi=n-1;
+
+	/* sorted by tid */
+	while(lo <= hi) {
+		int mid=(lo + hi) / 2;
+
+		if(t[mid].tid == tid) {
+			return(&t[mid]);
+		}
+		if(t[mid].tid < tid) {
+			lo=mid+1;
+		} else {
+			hi=mid-1;
+		}
+	}
+	return(NULL);
+}
+
+
+static int cmp_thread(const void *a, const void *b)
+{
+	return(((const struct rb_thread_s *)a)->tid - ((const struct rb_thread_s *)b)->tid);
+}
+
+
+/*
+ sample all pinned threads of pids, carrying over state from
+ the old sample; returns the # of threads in *threads or -1
+ */
+static int sample_threads(pid_t *pids, int n, cpu_set_t *allowed,
+			  struct rb_thread_s *old, int n_old,
+			  struct rb_thread_s **threads)
+{
+	struct rb_thread_s *t=NULL, *tmp;
+	int i, j, count=0, size=0;
+
+	for(i=0; i < n; i++) {
+		pid_t pid=pids[i], *tids;
+		int n_tids;
+
+		if((n_tids=get_threads(pid, &tids)) < 0) {
+			continue;
+		}
+
+		for(j=0; j < n_tids; j++) {
+			struct rb_thread_s *cur, *prev;
+			cpu_set_t mask;
+			int cpu;
+
+			if(sched_getaffinity(tids[j], sizeof(mask), &mask) == -1
+			   || CPU_COUNT(&mask) != 1) {
+				continue;
+			}
+			for(cpu=0; ! CPU_ISSET(cpu, &mask); cpu++)
+				;
+			if(CPU_COUNT(allowed) && ! CPU_ISSET(cpu, allowed)) {
+				continue;
+			}
+
+			if(count == size) {
+				size=(size ? size * 2 : 64);
+				if(! (tmp=realloc(t, size * sizeof(*t)))) {
+					free(tids);
+					free(t);
+					return(-1);
+				}
+				t=tmp;
+			}
+
+			cur=&t[count];
+			memset(cur, 0, sizeof(*cur));
+			cur->pid=pid;
+			cur->tid=tids[j];
+			cur->cpu=cpu;
+			if(read_schedstat(pid, tids[j], &(cur->stat))) {
+				continue;
+			}
+
+			if((prev=find_thread(old, n_old, cur->tid))) {
+				cur->d_run=cur->stat.run - prev->stat.run;
+				cur->d_wait=cur->stat.wait - prev->stat.wait;
+				cur->hold=(prev->hold ? prev->hold - 1 : 0);
+				/* someone else moved it - start over */
+				if(prev->cpu != cur->cpu) {
+					cur->fresh=1;
+				}
+			} else {
+				cur->fresh=1;
+			}
+			count++;
+		}
+		free(tids);
+	}
+
+	if(count) {
+		qsort(t, count, sizeof(*t), cmp_thread);
+	}
+	*threads=t;
+	return(count);
+}
+
+
+/*
+ one round of balancing: move up to r->moves threads away from the CPU
+ with the largest run delay; returns the # of moves
+ */
+static int balance(struct rebalance_s *r, struct rb_thread_s *t, int n,
+		   cpu_set_t *allowed, int *util)
+{
+	unsigned long long delay[CPU_SETSIZE];
+	int runners[CPU_SETSIZE];
+	unsigned long long interval_ns=r->interval * 1000000ULL;
+	int i, cpu, moves=0;
+
+	memset(delay, 0, sizeof(delay));
+	memset(runners, 0, sizeof(runners));
+	for(i=0; i < n; i++) {
+		delay[t[i].cpu] += t[i].d_wait;
+		runners[t[i].cpu]++;
+	}
+
+	while(moves < r->moves) {
+		int busiest=-1, idlest=-1, best=-1;
+		int util_best=0;
+		char comm[32];
+
+		/* a single thread has nobody to wait for among ours */
+		for(cpu=0; cpu < CPU_SETSIZE; cpu++) {
+			if(! CPU_ISSET(cpu, allowed)) {
+				continue;
+			}
+			if(runners[cpu] > 1 && (busiest < 0 || delay[cpu] > delay[busiest])) {
+				busiest=cpu;
+			}
+		}
+		if(busiest < 0 || delay[busiest] < r->threshold * 1000ULL) {
+			break;
+		}
+
+		for(cpu=0; cpu < CPU_SETSIZE; cpu++) {
+			if(CPU_ISSET(cpu, allowed) && cpu != busiest
+			   && (idlest < 0 || util[cpu] < util[idlest])) {
+				idlest=cpu;
+			}
+		}
+		if(idlest < 0) {
+			break;
+		}
+
+		/*
+		 the biggest thread which still leaves the target less busy
+		 than the source: anything bigger would only turn the
+		 imbalance around and be moved back next time
+		 */
+		for(i=0; i < n; i++) {
+			int u;
+
+			if(t[i].cpu != busiest || t[i].fresh || t[i].hold) {
+				continue;
+			}
+			u=(int)(t[i].d_run * PERMILLE / interval_ns);
+			if(util[idlest] + u < util[busiest] - u && (best < 0 || u > util_best)) {
+				best=i;
+				util_best=u;
+			}
+		}
+		if(best < 0) {
+			break;
+		}
+
+		printf("MOVE: PID %d TID %d (%s) CPU %d -> CPU %d, run delay %llu us,"
+		       " util %d.%d%% -> %d.%d%%%s\n",
+		       t[best].pid,
+		       t[best].tid,
+		       get_comm(t[best].pid, t[best].tid, comm, sizeof(comm)),
+		       busiest,
+		       idlest,
+		       t[best].d_wait / 1000,
+		       util[busiest] / 10, util[busiest] % 10,
+		       util[idlest] / 10, util[idlest] % 10,
+		       (r->dryrun ? " (dry run)" : "")
+		      );
+		fflush(stdout);
+
+		if(! r->dryrun) {
+			cpu_set_t mask;
+
+			CPU_ZERO(&mask);
+			CPU_SET(idlest, &mask);
+			if(sched_setaffinity(t[best].tid, sizeof(mask), &mask) == -1) {
+				decode_error("could not move TID %d to CPU %d", t[best].tid, idlest);
+				/* gone or not ours; don't try again for a while */
+				t[best].hold=r->hold;
+				continue;
+			}
+		}
+
+		/* account for the move as if it had happened in this interval */
+		util[busiest] -= util_best;
+		util[idlest] += util_best;
+		delay[busiest] -= t[best].d_wait;
+		runners[busiest]--;
+		runners[idlest]++;
+		t[best].cpu=idlest;
+		t[best].hold=r->hold;
+		moves++;
+	}
+	return(moves);
+}
+
+
+/*
+ run until interrupted, r->count intervals have passed or all PIDs are
+ gone; returns -1 if it could not even start
+ */
+int rebalance(struct rebalance_s *r, pid_t *pids, int n)
+{
+	struct rb_thread_s *threads=NULL, *prev=NULL;
+	struct cpustat_s *cpus, *prev_cpus;
+	static int util[CPU_SETSIZE];
+	cpu_set_t allowed;
+	long interval;
+	int n_threads=0, n_prev=0, total=0;
+	int i, cpu;
+
+	cpus=calloc(CPU_SETSIZE, sizeof(*cpus));
+	prev_cpus=calloc(CPU_SETSIZE, sizeof(*prev_cpus));
+	if(! cpus || ! prev_cpus) {
+		decode_error("could not allocate CPU statistics");
+		free(cpus);
+		free(prev_cpus);
+		return(-1);
+	}
+
+	catch_stop_signals();
+
+	allowed=r->allowed;
+	read_cpustat(prev_cpus, CPU_SETSIZE);
+
+	for(interval=0; ! stop_requested() && (! r->count || interval <= r->count); interval++) {
+		int moves;
+
+		n_threads=sample_threads(pids, n, &(r->allowed), prev, n_prev, &threads);
+		free(prev);
+		prev=NULL;
+		n_prev=0;
+
+		if(n_threads <= 0) {
+			errno=0;
+			decode_error("no pinned threads left to balance - exiting");
+			break;
+		}
+
+		/* without -a, balance among the CPUs the threads were given */
+		if(! CPU_COUNT(&(r->allowed)) && ! interval) {
+			CPU_ZERO(&allowed);
+			for(i=0; i < n_threads; i++) {
+				CPU_SET(threads[i].cpu, &allowed);
+			}
+		}
+
+		read_cpustat(cpus, CPU_SETSIZE);
+		for(cpu=0; cpu < CPU_SETSIZE; cpu++) {
+			unsigned long long d_total=cpus[cpu].total - prev_cpus[cpu].total;
+
+			util[cpu]=(d_total ? (int)((cpus[cpu].busy - prev_cpus[cpu].busy)
+						   * PERMILLE / d_total) : 0);
+		}
+		memcpy(prev_cpus, cpus, CPU_SETSIZE * sizeof(*cpus));
+
+		/* the first sample only gives the baseline */
+		if(interval) {
+			moves=balance(r, threads, n_threads, &allowed, util);
+			total += moves;
+			if(r->verbose) {
+				printf("REBALANCE: interval %ld, %d threads, %d moves\n",
+				       interval, n_threads, moves);
+				fflush(stdout);
+			}
+		}
+
+		prev=threads;
+		n_prev=n_threads;
+		threads=NULL;
+
+		if(r->count && interval == r->count) {
+			break;
+		}
+		sleep_ms(r->interval);
+	}
+
+	printf("REBALANCE: %d moves in %ld intervals\n", total, interval);
+
+	free(prev);
+	free(cpus);
+	free(prev_cpus);
+	return(0);
+}
@@ -0,0 +1,38 @@
+/*
+ Schedtool
+ (c) by Freek <email_undisclosed>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation version 2 of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ Please see the file LICENSE for details.
+
+ */
+
+/* parameters of -b, see rebalance_opts() for the defaults */
+struct rebalance_s {
+	/* ms between two samples */
+	long interval;
+	/* max migrations per interval */
+	int moves;
+	/* intervals a moved thread stays where it was put */
+	int hold;
+	/* run delay in us per interval below which a CPU is left alone */
+	long threshold;
+	/* stop after that many intervals, 0 for never */
+	long count;
+
+	int dryrun;
+	int verbose;
+	/* CPUs threads may be moved between, all of theirs if empty */
+	cpu_set_t allowed;
+};
+
+int rebalance_opts(char *opts, struct rebalance_s *r);
+int rebalance(struct rebalance_s *r, pid_t *pids, int n);
@@ -45,9 +45,19 @@
 #include <sched.h>
 #include <unistd.h>
 #include <stdint.h>
+#include <sys/syscall.h>
 
 #include "error.h"
 #include "util.h"
+#include "schedtool.h"
+#include "profile.h"
+#include "parse.h"
+#include "topology.h"
+#include "numa.h"
+#include "taskstat.h"
+#include "rebalance.h"
+#include "watchdog.h"
+#include "coresched.h"
 
 
 /* various operation modes: print/set/affinity/fork */
@@ -57,38 +67,17 @@
 #define MODE_AFFINITY	0x4
 #define MODE_EXEC	0x8
 #define MODE_NICE       0x10
+#define MODE_TRANSACT	0x20
+#define MODE_ALLORNOTHING	0x40
+#define MODE_STRICT	0x80
+#define MODE_NUMA	0x100
+#define MODE_DRYRUN	0x200
+#define MODE_REBALANCE	0x400
+#define MODE_WATCHDOG	0x800
+#define MODE_CORESCHED	0x1000
+#define MODE_SLICE	0x2000
 #define VERSION "1.3.0"
 
-/*
- constants are from the O(1)-sched kernel's include/sched.h
- I don't want to include kernel-headers.
- Included those defines for improved readability.
- */
-#undef SCHED_NORMAL
-#undef SCHED_FIFO
-#undef SCHED_RR
-#undef SCHED_BATCH
-#define SCHED_NORMAL	0
-#define SCHED_FIFO	1
-#define SCHED_RR	2
-#define SCHED_BATCH	3
-#define SCHED_ISO	4
-#define SCHED_IDLEPRIO	5
-
-/* for loops */
-#define SCHED_MIN SCHED_NORMAL
-#define SCHED_MAX SCHED_IDLEPRIO
-
-#define CHECK_RANGE_POLICY(p) (p <= SCHED_MAX && p >= SCHED_MIN)
-#define CHECK_RANGE_NICE(n) (n <= 20 && n >= -20)
-
-/*
- 4 bits of CPU_SETSIZE will naturally reduce to 1 char, so
- we'd only need [CPU_SETSIZE / 4 + 1]
- to be sure leave a bit of room and only do CPU_SETSIZE / 2
- */
-#define CPUSET_HEXSTRING(name) char name[CPU_SETSIZE / 2]
-
 char *TAB[] = {
 	"N: SCHED_NORMAL",
 	"F: SCHED_FIFO",
@@ -99,6 +88,39 @@ char *TAB[] = {
 	0
 };
 
+/*
+ snapshot of a PID's settings taken before we touch it in transactional
+ mode; changed holds the MODE_* bits which have been applied successfully
+ and have to be undone on rollback
+ */
+struct sched_state_s {
+	pid_t pid;
+	int policy;
+	struct sched_param param;
+	int nice;
+	cpu_set_t aff_mask;
+	/* for the slice; has_attr is 0 on kernels without sched_getattr() */
+	struct sched_attr_s attr;
+	int has_attr;
+	/* with -m all threads are moved, so all their affinities are saved */
+	pid_t *tids;
+	cpu_set_t *tid_masks;
+	int n_tids;
+	int changed;
+};
+
+/* lint findings are warnings, or errors when -S was given */
+#define lint_report(strict, ...) do { \
+		errno=0; \
+		if(strict) { \
+			decode_error(__VA_ARGS__); \
+		} else { \
+			printf("WARNING: "); \
+			printf(__VA_ARGS__); \
+			printf("\n"); \
+		} \
+	} while(0)
+
 /* call it engine_s in lack of a better name */
 struct engine_s {
 
@@ -106,7 +128,10 @@ struct engine_s {
 	int policy;
 	int prio;
         int nice;
+	/* in ns, 0 for none */
+	unsigned long long slice;
 	cpu_set_t aff_mask;
+	struct coresched_s core;
 
 	/* # of args when going in PID-mode */
 	int n;
@@ -115,17 +140,18 @@ struct engine_s {
 
 
 int engine(struct engine_s *e);
-int set_process(pid_t pid, int policy, int prio);
-static inline int val_to_char(int v);
-static char * cpuset_to_str(cpu_set_t *mask, char *str);
-static inline int char_to_val(int c);
-static int str_to_cpuset(cpu_set_t *mask, const char* str);
-int parse_affinity(cpu_set_t *, char *arg);
+int lint_affinity(cpu_set_t *mask, int strict);
+int lint_process(pid_t pid, int policy, cpu_set_t *mask, int strict);
 int set_affinity(pid_t pid, cpu_set_t *mask);
+int set_threads_affinity(pid_t pid, cpu_set_t *mask);
 int set_niceness(pid_t pid, int nice);
+int save_process(pid_t pid, struct sched_state_s *state, int threads);
+int rollback_process(struct sched_state_s *state);
+void free_state(struct sched_state_s *state);
+int slice_supported(struct sched_attr_s *attr);
 void probe_sched_features();
-void get_prio_min_max(int policy, int *min, int *max);
 void print_prio_min_max(int policy);
+void print_core_types(cpu_set_t *mask);
 void print_process(pid_t pid);
 void usage(void);
 
@@ -144,6 +170,25 @@ int main(int ac, char **dc)
 	 */
 	int policy=-1, nice=10, prio=0, mode=MODE_NOTHING;
 
+	/* slice: in us, only with MODE_SLICE */
+	int slice=0;
+
+	/*
+	 prof: what -P asked for; only used where no option says otherwise
+	 prio_given: -p seen, there's no mode for it
+	 */
+	struct profile_s prof;
+	int prio_given=0;
+	memset(&prof, 0, sizeof(prof));
+
+	/* parameters of the periodic modes */
+	struct rebalance_s rb;
+	struct watchdog_s wd;
+	struct coresched_s core;
+	memset(&rb, 0, sizeof(rb));
+	memset(&wd, 0, sizeof(wd));
+	memset(&core, 0, sizeof(core));
+
 	/*
 	 aff_mask: zero it out
 	 */
@@ -153,12 +198,16 @@ int main(int ac, char **dc)
         /* for getopt() */
 	int c;
 
+	/* PIDs of the periodic modes */
+	int i;
+	pid_t *pids=NULL;
+
 	if (ac < 2) {
 		usage();
 		return(0);
 	}
 
-	while((c=getopt(ac, dc, "+NFRBID012345M:a:p:n:ervh")) != -1) {
+	while((c=getopt(ac, dc, "+NFRBID012345M:a:p:n:s:P:ertTSmdb:w:c:vh")) != -1) {
 
 		switch(c) {
 		case '0':
@@ -193,26 +242,86 @@ int main(int ac, char **dc)
 			break;
 		case 'M':
 			/* manual setting */
-			policy=atoi(optarg);
+			if(parse_int(optarg, &policy)) {
+				decode_error("POLICY %s is not a number", optarg);
+				return(1);
+			}
 			mode |= MODE_SETPOLICY;
 			break;
 		case 'a':
 			mode |= MODE_AFFINITY;
-			parse_affinity(&aff_mask, optarg);
+			if(parse_affinity(&aff_mask, optarg)) {
+				return(1);
+			}
                         break;
 		case 'n':
                         mode |= MODE_NICE;
-			nice=atoi(optarg);
+			if(parse_int(optarg, &nice)) {
+				decode_error("NICE %s is not a number", optarg);
+				return(1);
+			}
                         break;
+		case 's':
+			mode |= MODE_SLICE;
+			if(parse_int(optarg, &slice)) {
+				decode_error("SLICE %s is not a number", optarg);
+				return(1);
+			}
+			break;
 		case 'e':
 			mode |= MODE_EXEC;
 			break;
 		case 'p':
-			prio=atoi(optarg);
+			if(parse_int(optarg, &prio)) {
+				decode_error("PRIO %s is not a number", optarg);
+				return(1);
+			}
+			prio_given=1;
+			break;
+		case 'P':
+			if(resolve_profiles(optarg, &prof)) {
+				return(1);
+			}
 			break;
 		case 'r':
                         probe_sched_features();
 			break;
+		case 'T':
+			/* all-or-nothing across all PIDs implies per-PID transactions */
+			mode |= MODE_ALLORNOTHING;
+			/* FALLTHROUGH */
+		case 't':
+			mode |= MODE_TRANSACT;
+			break;
+		case 'm':
+			/* affinity follows memory, computed per PID */
+			mode |= MODE_NUMA;
+			break;
+		case 'd':
+			mode |= MODE_DRYRUN;
+			break;
+		case 'b':
+			mode |= MODE_REBALANCE;
+			if(rebalance_opts(optarg, &rb)) {
+				return(1);
+			}
+			break;
+		case 'c':
+			mode |= MODE_CORESCHED;
+			if(coresched_opts(optarg, &core)) {
+				return(1);
+			}
+			break;
+		case 'w':
+			mode |= MODE_WATCHDOG;
+			if(watchdog_opts(optarg, &wd)) {
+				return(1);
+			}
+			break;
+		case 'S':
+			/* refuse instead of warn about questionable settings */
+			mode |= MODE_STRICT;
+			break;
 		case 'v':
                         /* the user wants feedback for each process */
 			mode |= MODE_PRINT;
@@ -228,6 +337,34 @@ int main(int ac, char **dc)
 		}
 	}
 
+	/*
+	 fill in from profiles what was not given explicitly; a profile's prio
+	 belongs to its policy, so with an explicit policy it's only taken if
+	 that one has static priorities, too
+	 */
+	if((prof.set & PROFILE_PRIO) && ! prio_given
+	   && (! mode_set(mode, MODE_SETPOLICY)
+	       || policy == SCHED_FIFO || policy == SCHED_RR || policy == SCHED_ISO)) {
+		prio=prof.prio;
+	}
+	if((prof.set & PROFILE_POLICY) && ! mode_set(mode, MODE_SETPOLICY)) {
+		policy=prof.policy;
+		mode |= MODE_SETPOLICY;
+	}
+	if((prof.set & PROFILE_NICE) && ! mode_set(mode, MODE_NICE)) {
+		nice=prof.nice;
+		mode |= MODE_NICE;
+	}
+	if((prof.set & PROFILE_AFFINITY) && ! mode_set(mode, MODE_AFFINITY)) {
+		aff_mask=prof.aff_mask;
+		mode |= MODE_AFFINITY;
+	}
+	if((prof.set & PROFILE_SLICE) && ! mode_set(mode, MODE_SLICE)
+	   && (! mode_set(mode, MODE_SETPOLICY) || IS_FAIR_POLICY(policy))) {
+		slice=prof.slice;
+		mode |= MODE_SLICE;
+	}
+
 	/*
          DAMN FUCKING
 	 parameter checking
@@ -242,7 +379,6 @@ int main(int ac, char **dc)
 	/* _FIFO and _RR MUST have prio set */
 	} else if((policy==SCHED_FIFO || policy==SCHED_RR || policy==SCHED_ISO)) {
 
-#define CHECK_RANGE_PRIO(p, p_low, p_high) (p <= (p_high) && p >= (p_low))
 		/* FIFO and RR - check min/max priority */
 		int prio_min, prio_max;
 
@@ -265,17 +401,91 @@ int main(int ac, char **dc)
 			/* treat as all calls have failed */
 			return(ac-optind);
 		}
-#undef CHECK_RANGE_PRIO
 	}
 
-	/* no mode -> do querying */
-	if(! mode) {
+	/* EEVDF slices are a fair class thing */
+	if(mode_set(mode, MODE_SLICE)) {
+		struct sched_attr_s attr;
+		int supported;
+
+		if(! CHECK_RANGE_SLICE(slice)) {
+			decode_error("SLICE %d is out of range %d-%d us", slice, SLICE_MIN, SLICE_MAX);
+			return(-1);
+		}
+		if(mode_set(mode, MODE_SETPOLICY) && ! IS_FAIR_POLICY(policy)) {
+			decode_error("slice only applies to SCHED_NORMAL and SCHED_BATCH - exiting");
+			return(-1);
+		}
+		/*
+		 refuse before touching any PID: sched_setattr() would change
+		 the policy before we could notice the slice being ignored
+		 */
+		if((supported=slice_supported(&attr)) == 0 || supported == -1) {
+			decode_error("kernel does not support custom slices (needs linux 6.12+) - exiting");
+			return(-1);
+		}
+	}
+
+	if(mode_set(mode, MODE_AFFINITY)
+	   && lint_affinity(&aff_mask, mode_set(mode, MODE_STRICT))
+	   && mode_set(mode, MODE_STRICT)) {
+		return(ac-optind);
+	}
+
+	if(mode_set(mode, MODE_NUMA) && (mode_set(mode, MODE_AFFINITY) || mode_set(mode, MODE_EXEC))) {
+		decode_error("Option -m can't be combined with -a or -e - exiting");
+		return(-1);
+	}
+
+	/* the periodic modes sample their PIDs again and again, so parse them once */
+	if(mode & (MODE_REBALANCE | MODE_WATCHDOG)) {
+		if(! (pids=calloc(ac - optind + 1, sizeof(pid_t)))) {
+			decode_error("could not allocate PIDs - exiting");
+			return(-1);
+		}
+		for(i=optind; i < ac; i++) {
+			if(parse_pid(dc[i], &pids[i - optind])) {
+				decode_error("%s is not a PID - exiting", dc[i]);
+				return(-1);
+			}
+		}
+	}
+
+	/* the rebalancer doesn't set anything but affinities, and runs on its own */
+	if(mode_set(mode, MODE_REBALANCE)) {
+		if(mode & ~(MODE_REBALANCE | MODE_AFFINITY | MODE_DRYRUN | MODE_PRINT)) {
+			decode_error("Option -b can only be combined with -a, -d and -v - exiting");
+			return(-1);
+		}
+		if(mode_set(mode, MODE_AFFINITY)) {
+			rb.allowed=aff_mask;
+		}
+		rb.dryrun=mode_set(mode, MODE_DRYRUN);
+		rb.verbose=mode_set(mode, MODE_PRINT);
+		return(abs(rebalance(&rb, pids, ac-optind)));
+	}
+
+	/* the watchdog only demotes/promotes, and runs on its own, too */
+	if(mode_set(mode, MODE_WATCHDOG)) {
+		if(mode & ~(MODE_WATCHDOG | MODE_DRYRUN | MODE_PRINT)) {
+			decode_error("Option -w can only be combined with -d and -v - exiting");
+			return(-1);
+		}
+		wd.dryrun=mode_set(mode, MODE_DRYRUN);
+		wd.verbose=mode_set(mode, MODE_PRINT);
+		return(abs(watchdog(&wd, pids, ac-optind)));
+	}
+
+	/* no mode -> do querying; -t/-T/-S/-d alone don't change anything */
+	if(! (mode & ~(MODE_TRANSACT | MODE_ALLORNOTHING | MODE_STRICT | MODE_DRYRUN))) {
 		mode |= MODE_PRINT;
 	}
 
 	if( mode_set(mode, MODE_EXEC) && ! ( mode_set(mode, MODE_SETPOLICY)
 					     || mode_set(mode, MODE_AFFINITY)
-                                             || mode_set(mode, MODE_NICE) )
+                                             || mode_set(mode, MODE_NICE)
+					     || mode_set(mode, MODE_SLICE)
+					     || mode_set(mode, MODE_CORESCHED) )
 
 	  ) {
 		/* we have nothing to do */
@@ -287,7 +497,12 @@ int main(int ac, char **dc)
 		decode_error("NICE %d is out of range -20 to 20", nice);
                 return(-1);
 	}
-#undef CHECK_RANGE_NICE
+
+	/* sharing and clearing cookies goes through our own one */
+	if(mode_set(mode, MODE_CORESCHED) && ! mode_set(mode, MODE_DRYRUN)
+	   && coresched_prepare(&core)) {
+		return(ac-optind);
+	}
 
 	/* and: ignition */
 	{
@@ -298,6 +513,8 @@ int main(int ac, char **dc)
 		stuff.prio=prio;
 		stuff.aff_mask=aff_mask;
 		stuff.nice=nice;
+		stuff.slice=(mode_set(mode, MODE_SLICE) ? slice * 1000ULL : 0);
+		stuff.core=core;
 
                 /* we have this much real args/PIDs to process */
 		stuff.n=ac-optind;
@@ -315,6 +532,11 @@ int engine(struct engine_s *e)
 {
 	int ret=0;
 	int i;
+	/* only used in transactional mode */
+	struct sched_state_s *states=NULL;
+	/* PIDs printed, to find the ones sharing a core scheduling cookie */
+	pid_t *printed=NULL;
+	int n_printed=0;
 
 #ifdef DEBUG
 	do {
@@ -328,6 +550,22 @@ int engine(struct engine_s *e)
 	} while(0);
 #endif
 
+	if(mode_set(e->mode, MODE_TRANSACT) && e->n > 0) {
+		if(! (states=calloc(e->n, sizeof(*states)))) {
+			decode_error("could not allocate rollback state");
+			return(e->n);
+		}
+	}
+
+	if(mode_set(e->mode, MODE_PRINT) && e->n > 1) {
+		printed=calloc(e->n, sizeof(*printed));
+	}
+
+	if(mode_set(e->mode, MODE_NUMA)
+	   && (mode_set(e->mode, MODE_DRYRUN) || mode_set(e->mode, MODE_PRINT))) {
+		print_numa_header();
+	}
+
 	/*
 	 handle normal query/set operation:
 	 set/query all given PIDs
@@ -336,6 +574,10 @@ int engine(struct engine_s *e)
 
 		int pid, tmpret=0;
 		cpu_set_t affi;
+		struct sched_state_s *state=NULL;
+		/* the affinity to set, if any; -m gives each PID its own */
+		cpu_set_t *aff_mask=NULL;
+		struct numa_info_s numa;
 
 		CPU_ZERO(&affi);
                 CPU_SET(0, &affi);
@@ -346,27 +588,82 @@ int engine(struct engine_s *e)
 			goto exec_mode_special;
 		}
 
-		if(! (isdigit( *(e->args[i])) ) ) {
+		if(parse_pid(e->args[i], &pid)) {
 			decode_error("Ignoring arg %s: is not a PID", e->args[i]);
 			continue;
 		}
 
-		pid=atoi(e->args[i]);
-
 	exec_mode_special:
-		if(mode_set(e->mode, MODE_SETPOLICY)) {
+		if(mode_set(e->mode, MODE_AFFINITY)) {
+			aff_mask=&(e->aff_mask);
+
+		} else if(mode_set(e->mode, MODE_NUMA)) {
+			switch(numa_placement(pid, &numa)) {
+			case 0:
+				aff_mask=&(numa.cpus);
+				break;
+			case 1:
+				/* nothing resident - nothing to follow, not an error */
+				break;
+			default:
+				ret--;
+				goto failed;
+			}
+			if(mode_set(e->mode, MODE_DRYRUN) || mode_set(e->mode, MODE_PRINT)) {
+				print_numa(pid, &numa);
+			}
+		}
+
+		/* only lint what is going to be changed */
+		if((mode_set(e->mode, MODE_SETPOLICY) || aff_mask)
+		   && lint_process(pid,
+				   (mode_set(e->mode, MODE_SETPOLICY) ? e->policy : -1),
+				   aff_mask,
+				   mode_set(e->mode, MODE_STRICT))
+		   && mode_set(e->mode, MODE_STRICT)) {
+			ret--;
+			goto failed;
+		}
+
+		/* report only, change nothing */
+		if(mode_set(e->mode, MODE_DRYRUN)) {
+			if(mode_set(e->mode, MODE_PRINT) && ! mode_set(e->mode, MODE_NUMA)) {
+				print_process(pid);
+			}
+			continue;
+		}
+
+		if(states) {
+			/*
+			 without a snapshot we could not undo anything,
+			 so don't even start changing this PID
+			 */
+			state=&states[i];
+			if(save_process(pid, state, mode_set(e->mode, MODE_NUMA))) {
+				ret--;
+				goto failed;
+			}
+		}
+
+		if(mode_set(e->mode, MODE_SETPOLICY) || mode_set(e->mode, MODE_SLICE)) {
 			/*
 			 accumulate possible errors
 			 the return value of main will indicate
 			 how much set-calls went wrong
                          set_process returns -1 upon failure
 			 */
-			tmpret=set_process(pid,e->policy,e->prio);
+			tmpret=set_process(pid,
+					   (mode_set(e->mode, MODE_SETPOLICY) ? e->policy : -1),
+					   e->prio,
+					   e->slice);
 			ret += tmpret;
 
                         /* don't proceed as something went wrong already */
 			if(tmpret) {
-				continue;
+				goto failed;
+			}
+			if(state) {
+				state->changed |= (e->mode & (MODE_SETPOLICY | MODE_SLICE));
 			}
 
 		}
@@ -376,17 +673,36 @@ int engine(struct engine_s *e)
                         ret += tmpret;
 
 			if(tmpret) {
-				continue;
+				goto failed;
+			}
+			if(state) {
+				state->changed |= MODE_NICE;
 			}
 
 		}
 
-		if(mode_set(e->mode, MODE_AFFINITY)) {
-			tmpret=set_affinity(pid, &(e->aff_mask));
+		if(aff_mask) {
+			/* the memory belongs to all threads, so all of them follow it */
+			tmpret=(mode_set(e->mode, MODE_NUMA) ? set_threads_affinity(pid, aff_mask)
+				: set_affinity(pid, aff_mask));
 			ret += tmpret;
 
 			if(tmpret) {
-				continue;
+				goto failed;
+			}
+			if(state) {
+				state->changed |= MODE_AFFINITY;
+			}
+
+		}
+
+		/* last, as a cookie can't be rolled back */
+		if(mode_set(e->mode, MODE_CORESCHED)) {
+			tmpret=set_core_cookie(pid, &(e->core));
+			ret += tmpret;
+
+			if(tmpret) {
+				goto failed;
 			}
 
 		}
@@ -394,6 +710,9 @@ int engine(struct engine_s *e)
 		/* and print process info when set, too */
 		if(mode_set(e->mode, MODE_PRINT)) {
 			print_process(pid);
+			if(printed) {
+				printed[n_printed++]=pid;
+			}
 		}
 
 
@@ -402,13 +721,54 @@ int engine(struct engine_s *e)
 
 			char **new_argv=e->args;
 
+			free(states);
+			free(printed);
 			ret=execvp(*new_argv, new_argv);
 
 			/* only reached on error */
 			decode_error("schedtool: Could not exec %s", *new_argv);
 			return(ret);
 		}
+		continue;
+
+	failed:
+		if(! states) {
+			continue;
+		}
+
+		/* undo what has been applied to this PID so far, if anything */
+		if(state) {
+			ret += rollback_process(state);
+		}
+
+		if(mode_set(e->mode, MODE_ALLORNOTHING)) {
+			int j;
+
+			/* ... and to all PIDs before, then leave the rest untouched */
+			for(j=i-1; j >= 0; j--) {
+				ret += rollback_process(&states[j]);
+			}
+			if(i + 1 < e->n && ! mode_set(e->mode, MODE_EXEC)) {
+				printf("ROLLBACK: %d remaining PIDs not touched\n", e->n - i - 1);
+			}
+			/* count everything not applied as failed */
+			ret=-e->n;
+			break;
+		}
+	}
+
+	if(states) {
+		for(i=0; i < e->n; i++) {
+			free_state(&states[i]);
+		}
+		free(states);
+	}
+
+	if(printed) {
+		print_cookie_groups(printed, n_printed);
+		free(printed);
 	}
+
 	/*
 	 indicate how many errors we got; as ret is accumulated negative,
 	 convert to positive
@@ -417,14 +777,54 @@ int engine(struct engine_s *e)
 }
 
 
-int set_process(pid_t pid, int policy, int prio)
+/*
+ a nonzero slice (ns) goes through sched_setattr(), as sched_setscheduler()
+ knows nothing about it; policy -1 keeps the current policy then
+ */
+int set_process(pid_t pid, int policy, int prio, unsigned long long slice)
 {
 	struct sched_param p;
+	struct sched_attr_s attr;
 	int ret;
 
 	char *msg1="could not set PID %d to %s";
 	char *msg2="could not set PID %d to raw policy #%d";
 
+	if(slice) {
+		if(sched_getattr_s(pid, &attr)) {
+			decode_error("could not get scheduling-information for PID %d", pid);
+			return(-1);
+		}
+		if(policy >= 0) {
+			attr.sched_policy=policy;
+			attr.sched_priority=prio;
+		}
+		if(! IS_FAIR_POLICY(attr.sched_policy)) {
+			errno=0;
+			decode_error("PID %d: slice only applies to SCHED_NORMAL and SCHED_BATCH", pid);
+			return(-1);
+		}
+		/* keep nice (returned by getattr) and reset-on-fork, nothing else */
+		attr.sched_flags &= SCHED_FLAG_RESET_ON_FORK;
+		attr.sched_runtime=slice;
+
+		if((ret=sched_setattr_s(pid, &attr))) {
+			decode_error("could not set PID %d to slice %llu us", pid, slice / 1000);
+			return(ret);
+		}
+
+		/*
+		 kernels before 6.12 accept sched_runtime for fair tasks, but
+		 silently ignore it; catch that by reading it back
+		 */
+		if(sched_getattr_s(pid, &attr) || attr.sched_runtime != slice) {
+			errno=0;
+			decode_error("PID %d: kernel does not support custom slices (needs linux 6.12+)", pid);
+			return(-1);
+		}
+		return(0);
+	}
+
 	p.sched_priority=prio;
 
 	/* anything other than 0 indicates error */
@@ -442,137 +842,103 @@ int set_process(pid_t pid, int policy, int prio)
 
 
 /*
- the following functions have been taken from taskset of util-linux
- (C) 2004 by Robert Love
+ no glibc wrappers for these before 2.41; the size is passed explicitly,
+ so older and newer kernels both accept our VER0 struct
  */
-static inline int val_to_char(int v)
+int sched_getattr_s(pid_t pid, struct sched_attr_s *attr)
 {
-	if (v >= 0 && v < 10)
-		return '0' + v;
-	else if (v >= 10 && v < 16)
-		return ('a' - 10) + v;
-	else 
-		return -1;
+	memset(attr, 0, sizeof(*attr));
+	return(syscall(SYS_sched_getattr, pid, attr, sizeof(*attr), 0) ? -1 : 0);
 }
 
 
-/*
- str seems to need to hold [CPU_SETSIZE * 7] chars, as in used in taskset
- however, 4 bits of CPU_SETSIZE will naturally reduce to 1 char
- (bits "1111" -> char "f") so CPU_SETSIZE / 4 + 1 should be sufficient
-
- will pad with zeroes to the start, so print the string starting at the
- returned char *
- */
-static char * cpuset_to_str(cpu_set_t *mask, char *str)
+int sched_setattr_s(pid_t pid, struct sched_attr_s *attr)
 {
-	int base;
-	char *ptr = str;
-	char *ret = 0;
-
-	for (base = CPU_SETSIZE - 4; base >= 0; base -= 4) {
-		char val = 0;
-		if (CPU_ISSET(base, mask))
-			val |= 1;
-		if (CPU_ISSET(base + 1, mask))
-			val |= 2;
-		if (CPU_ISSET(base + 2, mask))
-			val |= 4;
-		if (CPU_ISSET(base + 3, mask))
-			val |= 8;
-		if (!ret && val)
-			ret = ptr;
-		*ptr++ = val_to_char(val);
-	}
-	*ptr = 0;
-	return ret ? ret : ptr - 1;
+	attr->size=sizeof(*attr);
+	return(syscall(SYS_sched_setattr, pid, attr, 0) ? -1 : 0);
 }
 
 
-static inline int char_to_val(int c)
+/*
+ sanity checks of the requested affinity against the CPUs of the box;
+ returns the # of problems found, reported as errors when strict
+ */
+int lint_affinity(cpu_set_t *mask, int strict)
 {
-	int cl;
-
-	cl = tolower(c);
-	if (c >= '0' && c <= '9')
-		return c - '0';
-	else if (cl >= 'a' && cl <= 'f')
-		return cl + (10 - 'a');
-	else
-		return -1;
-}
+	cpu_set_t online, offline;
+	CPUSET_HEXSTRING(aff_hex);
 
+	get_online_cpus(&online);
+	CPU_XOR(&offline, mask, &online);
+	CPU_AND(&offline, &offline, mask);
 
-static int str_to_cpuset(cpu_set_t *mask, const char* str)
-{
-	int len = strlen(str);
-	const char *ptr = str + len - 1;
-	int base = 0;
-
-	/* skip 0x, it's all hex anyway */
-	if(len > 1 && str[0] == '0' && str[1] == 'x') {
-		str += 2;
-	}
-
-	CPU_ZERO(mask);
-	while (ptr >= str) {
-		char val = char_to_val(*ptr);
-		if (val == (char) -1)
-			return -1;
-		if (val & 1)
-			CPU_SET(base, mask);
-		if (val & 2)
-			CPU_SET(base + 1, mask);
-		if (val & 4)
-			CPU_SET(base + 2, mask);
-		if (val & 8)
-			CPU_SET(base + 3, mask);
-		len--;
-		ptr--;
-		base += 4;
-	}
-
-	return 0;
+	if(CPU_COUNT(&offline)) {
+		lint_report(strict, "affinity includes offline/non-existent CPUs 0x%s",
+			    cpuset_to_str(&offline, aff_hex));
+		return(1);
+	}
+	return(0);
 }
-/* end of functions taken */
 
 
-/* mhm - we need something clever for all that CPU_SET() and CPU_ISSET() stuff */
-int parse_affinity(cpu_set_t *mask, char *arg)
+/*
+ check the policy and affinity a PID is going to end up with; policy -1
+ and mask NULL mean it keeps its current one:
+ - RT and deadline tasks belong onto isolated (isolcpus/nohz_full) CPUs,
+   if the box has any
+ - batch and idle work doesn't belong there
+ - the affinity has to intersect the PID's cpuset cgroup
+ returns the # of problems found, reported as errors when strict
+ */
+int lint_process(pid_t pid, int policy, cpu_set_t *new_mask, int strict)
 {
-	cpu_set_t tmp_aff;
-	char *tmp_arg;
-	size_t valid_len;
-
-        CPU_ZERO(&tmp_aff);
-
-	if(*arg == '0' && *(arg+1) == 'x') {
-		/* we're in standard hex mode */
-		str_to_cpuset(&tmp_aff, arg);
-
-	} else if( (valid_len=strspn(arg, "0123456789,.")) ) {
-		/* new list mode: schedtool -a 0,2 -> run on CPU0 and CPU2 */
+	int problems=0;
+	cpu_set_t mask, isolated, tmp;
+	CPUSET_HEXSTRING(aff_hex);
 
-		/* split on ',' and '.', because '.' is near ',' :) */
-		while((tmp_arg=strsep(&arg, ",."))) {
-                        int tmp_cpu;
+	if(new_mask) {
+		mask=*new_mask;
+	} else if(sched_getaffinity(pid, sizeof(mask), &mask) == -1) {
+		/* set_*() will complain */
+		return(0);
+	}
 
-			if(isdigit((int)*tmp_arg)) {
-				tmp_cpu=atoi(tmp_arg);
-                                CPU_SET(tmp_cpu, &tmp_aff);
-#ifdef DEBUG
-				printf("tmp_arg: %s -> tmp_cpu: %d\n", tmp_arg, tmp_cpu);
-#endif
+	if(policy < 0 && (policy=sched_getscheduler(pid)) < 0) {
+		return(0);
+	}
+	policy &= ~SCHED_RESET_ON_FORK;
+
+	get_isolated_cpus(&isolated);
+
+	if(CPU_COUNT(&isolated)) {
+		if(IS_RT_POLICY(policy)) {
+			CPU_XOR(&tmp, &mask, &isolated);
+			CPU_AND(&tmp, &tmp, &mask);
+			if(CPU_COUNT(&tmp)) {
+				lint_report(strict, "PID %d: real-time policy on non-isolated CPUs 0x%s",
+					    pid, cpuset_to_str(&tmp, aff_hex));
+				problems++;
+			}
+		} else if(policy == SCHED_BATCH || policy == SCHED_IDLEPRIO) {
+			CPU_AND(&tmp, &mask, &isolated);
+			if(CPU_COUNT(&tmp)) {
+				lint_report(strict, "PID %d: batch/idle policy on isolated CPUs 0x%s",
+					    pid, cpuset_to_str(&tmp, aff_hex));
+				problems++;
 			}
 		}
+	}
 
-	} else {
-		decode_error("affinity %s is not parseable", arg);
-		exit(1);
+	if(! task_cpuset(pid, &tmp)) {
+		CPU_AND(&tmp, &tmp, &mask);
+		if(! CPU_COUNT(&tmp)) {
+			lint_report(strict, "PID %d: affinity 0x%s does not intersect its cpuset",
+				    pid, cpuset_to_str(&mask, aff_hex));
+			problems++;
+		}
 	}
 
-        *mask=tmp_aff;
-	return 0;
+	return(problems);
 }
 
 
@@ -592,6 +958,37 @@ int set_affinity(pid_t pid, cpu_set_t *mask)
 }
 
 
+/*
+ all threads of pid, which may come and go meanwhile; one which is gone
+ when we get to it is no error
+ */
+int set_threads_affinity(pid_t pid, cpu_set_t *mask)
+{
+	pid_t *tids;
+	int i, n, ret=0;
+	CPUSET_HEXSTRING(aff_hex);
+
+	if((n=get_threads(pid, &tids)) < 0) {
+		return(set_affinity(pid, mask));
+	}
+	for(i=0; i < n; i++) {
+		if(sched_setaffinity(tids[i], sizeof(cpu_set_t), mask) == -1 && errno != ESRCH) {
+			/* the caller rolls back what has been moved so far */
+			decode_error("could not set TID %d of PID %d to affinity 0x%s",
+				     tids[i],
+				     pid,
+				     cpuset_to_str(mask, aff_hex)
+				    );
+			ret=-1;
+			break;
+		}
+	}
+	errno=0;
+	free(tids);
+	return(ret);
+}
+
+
 int set_niceness(pid_t pid, int nice)
 {
 	int ret;
@@ -607,16 +1004,279 @@ int set_niceness(pid_t pid, int nice)
 }
 
 
+/*
+ remember policy, static priority, nice level, slice and affinity of a PID so
+ rollback_process() can restore them later
+ */
+int save_process(pid_t pid, struct sched_state_s *state, int threads)
+{
+	int i;
+
+	memset(state, 0, sizeof(*state));
+	state->pid=pid;
+
+	errno=0;
+	if( ((state->policy=sched_getscheduler(pid)) < 0)
+	    || (sched_getparam(pid, &(state->param)) < 0)
+	    || ((state->nice=getpriority(PRIO_PROCESS, pid)) && errno)
+	    || (sched_getaffinity(pid, sizeof(state->aff_mask), &(state->aff_mask)) == -1)
+	  ) {
+		decode_error("could not save settings of PID %d - not touching it", pid);
+		return(-1);
+	}
+	/* only needed to restore a slice; may fail on pre-3.14 kernels */
+	state->has_attr=! sched_getattr_s(pid, &(state->attr));
+	errno=0;
+
+	if(threads && (state->n_tids=get_threads(pid, &(state->tids))) > 0) {
+		if(! (state->tid_masks=calloc(state->n_tids, sizeof(cpu_set_t)))) {
+			decode_error("could not save settings of PID %d - not touching it", pid);
+			free_state(state);
+			return(-1);
+		}
+		for(i=0; i < state->n_tids; i++) {
+			/* gone already; restoring it will fail quietly, too */
+			if(sched_getaffinity(state->tids[i], sizeof(cpu_set_t), &(state->tid_masks[i])) == -1) {
+				state->tid_masks[i]=state->aff_mask;
+			}
+		}
+		errno=0;
+	}
+	return(0);
+}
+
+
+/*
+ the slice of fair tasks which didn't ask for one, in ns: base_slice_ns of
+ debugfs, else what the kernel derives from the # of CPUs,
+ 0.7ms * (1 + log2(min(cpus, 8)))
+ */
+static unsigned long long default_slice(void)
+{
+	FILE *f;
+	unsigned long long slice=0;
+	long cpus;
+	int factor=1;
+
+	if((f=fopen("/sys/kernel/debug/sched/base_slice_ns", "r"))) {
+		if(fscanf(f, "%llu", &slice) != 1) {
+			slice=0;
+		}
+		fclose(f);
+	}
+	if(slice) {
+		return(slice);
+	}
+
+	cpus=sysconf(_SC_NPROCESSORS_ONLN);
+	for(cpus=(cpus > 8 ? 8 : cpus); cpus > 1; cpus >>= 1) {
+		factor++;
+	}
+	return(700000ULL * factor);
+}
+
+
+/*
+ restore everything set_process(), set_niceness() and set_affinity() have
+ changed and report each restored setting; returns -1 if any of it failed
+ */
+int rollback_process(struct sched_state_s *state)
+{
+	int i, ret=0;
+	CPUSET_HEXSTRING(aff_hex);
+	char policy_str[32];
+
+	if(! state->changed) {
+		return(0);
+	}
+
+	/* in reverse order of engine() */
+	if(mode_set(state->changed, MODE_AFFINITY) && state->n_tids > 0) {
+		for(i=0; i < state->n_tids; i++) {
+			if(sched_setaffinity(state->tids[i], sizeof(cpu_set_t), &(state->tid_masks[i])) == -1
+			   && errno != ESRCH) {
+				decode_error("could not roll back TID %d of PID %d to affinity 0x%s",
+					     state->tids[i],
+					     state->pid,
+					     cpuset_to_str(&(state->tid_masks[i]), aff_hex)
+					    );
+				ret=-1;
+			}
+		}
+		errno=0;
+		printf("ROLLBACK: PID %d restored to AFFINITY 0x%s, %d threads\n",
+		       state->pid,
+		       cpuset_to_str(&(state->aff_mask), aff_hex),
+		       state->n_tids
+		      );
+
+	} else if(mode_set(state->changed, MODE_AFFINITY)) {
+		if(sched_setaffinity(state->pid, sizeof(cpu_set_t), &(state->aff_mask)) == -1) {
+			decode_error("could not roll back PID %d to affinity 0x%s",
+				     state->pid,
+				     cpuset_to_str(&(state->aff_mask), aff_hex)
+				    );
+			ret=-1;
+		} else {
+			printf("ROLLBACK: PID %d restored to AFFINITY 0x%s\n",
+			       state->pid,
+			       cpuset_to_str(&(state->aff_mask), aff_hex)
+			      );
+		}
+	}
+
+	if(mode_set(state->changed, MODE_NICE)) {
+		if(setpriority(PRIO_PROCESS, state->pid, state->nice)) {
+			decode_error("could not roll back PID %d to nice %d",
+				     state->pid,
+				     state->nice
+				    );
+			ret=-1;
+		} else {
+			printf("ROLLBACK: PID %d restored to NICE %d\n",
+			       state->pid,
+			       state->nice
+			      );
+		}
+	}
+
+	/*
+	 the attr also holds nice, the slice and the SCHED_DEADLINE parameters,
+	 which sched_setscheduler() can neither restore nor set at all
+	 */
+	if((state->changed & (MODE_SETPOLICY | MODE_SLICE)) && state->has_attr) {
+		if(CHECK_RANGE_POLICY(state->policy)) {
+			snprintf(policy_str, sizeof(policy_str), "POLICY %s", TAB[state->policy]);
+		} else {
+			snprintf(policy_str, sizeof(policy_str), "raw POLICY #%d", state->policy);
+		}
+		state->attr.sched_flags &= SCHED_FLAG_RESET_ON_FORK;
+		/*
+		 fair tasks without a custom slice report the default one; writing
+		 that back would make it custom, 0 gets the default back instead
+		 */
+		if(IS_FAIR_POLICY(state->attr.sched_policy)
+		   && state->attr.sched_runtime == default_slice()) {
+			state->attr.sched_runtime=0;
+		}
+		if(sched_setattr_s(state->pid, &(state->attr))) {
+			decode_error("could not roll back PID %d to raw policy #%d, prio %d",
+				     state->pid,
+				     state->policy,
+				     state->param.sched_priority
+				    );
+			ret=-1;
+		} else if(! IS_FAIR_POLICY(state->attr.sched_policy)) {
+			printf("ROLLBACK: PID %d restored to %s, PRIO %d\n",
+			       state->pid,
+			       policy_str,
+			       state->param.sched_priority
+			      );
+		} else if(! state->attr.sched_runtime) {
+			printf("ROLLBACK: PID %d restored to %s, PRIO %d, default SLICE\n",
+			       state->pid,
+			       policy_str,
+			       state->param.sched_priority
+			      );
+		} else {
+			printf("ROLLBACK: PID %d restored to %s, PRIO %d, SLICE %llu us\n",
+			       state->pid,
+			       policy_str,
+			       state->param.sched_priority,
+			       state->attr.sched_runtime / 1000
+			      );
+		}
+
+	} else if(state->changed & (MODE_SETPOLICY | MODE_SLICE)) {
+		if(sched_setscheduler(state->pid, state->policy, &(state->param))) {
+			decode_error("could not roll back PID %d to raw policy #%d, prio %d",
+				     state->pid,
+				     state->policy,
+				     state->param.sched_priority
+				    );
+			ret=-1;
+		} else if(CHECK_RANGE_POLICY(state->policy)) {
+			printf("ROLLBACK: PID %d restored to POLICY %s, PRIO %d\n",
+			       state->pid,
+			       TAB[state->policy],
+			       state->param.sched_priority
+			      );
+		} else {
+			printf("ROLLBACK: PID %d restored to raw POLICY #%d, PRIO %d\n",
+			       state->pid,
+			       state->policy,
+			       state->param.sched_priority
+			      );
+		}
+	}
+
+	state->changed=0;
+	return(ret);
+}
+
+
+void free_state(struct sched_state_s *state)
+{
+	free(state->tids);
+	free(state->tid_masks);
+	state->tids=NULL;
+	state->tid_masks=NULL;
+	state->n_tids=0;
+}
+
+
+/*
+ EEVDF kernels report the slice of fair tasks as sched_runtime, so look
+ at our own; returns 1 if custom slices are supported, 0 if not, -1
+ without sched_getattr and -2 if we can't tell as we're not a fair task
+ */
+int slice_supported(struct sched_attr_s *attr)
+{
+	int ret;
+
+	if(sched_getattr_s(0, attr)) {
+		ret=-1;
+	} else if(! IS_FAIR_POLICY(attr->sched_policy)) {
+		ret=-2;
+	} else {
+		ret=(attr->sched_runtime != 0);
+	}
+	errno=0;
+	return(ret);
+}
+
+
 /*
  probe some features; just basic right now
  */
 void probe_sched_features()
 {
 	int i;
+	struct sched_attr_s attr;
 
 	for(i=SCHED_MIN; i <= SCHED_MAX; i++) {
 		print_prio_min_max(i);
  	}
+
+	switch(slice_supported(&attr)) {
+	case -1:
+		printf("%-17s: not supported (no sched_getattr)\n", "custom slice");
+		break;
+	case -2:
+		printf("%-17s: unknown (run probe as SCHED_NORMAL)\n", "custom slice");
+		break;
+	case 0:
+		printf("%-17s: not supported (needs linux 6.12+)\n", "custom slice");
+		break;
+	default:
+		printf("%-17s: slice_min %d us, slice_max %d us, current %llu us\n",
+		       "custom slice",
+		       SLICE_MIN,
+		       SLICE_MAX,
+		       attr.sched_runtime / 1000
+		      );
+		break;
+	}
 }
 
 
@@ -650,6 +1310,27 @@ void print_prio_min_max(int policy)
 }
 
 
+/*
+ on hybrid CPUs, label the CPUs of an affinity by core type, e.g.
+ " [P 0-7, E 8-15]", so misplaced tasks stand out
+ */
+void print_core_types(cpu_set_t *mask)
+{
+	cpu_set_t pcores, ecores;
+	char list[CPU_SETSIZE * 4];
+
+	if(get_core_types(&pcores, &ecores)) {
+		return;
+	}
+
+	CPU_AND(&pcores, &pcores, mask);
+	CPU_AND(&ecores, &ecores, mask);
+
+	printf(" [P %s", CPU_COUNT(&pcores) ? cpuset_to_cpulist(&pcores, list, sizeof(list)) : "-");
+	printf(", E %s]", CPU_COUNT(&ecores) ? cpuset_to_cpulist(&ecores, list, sizeof(list)) : "-");
+}
+
+
 /*
  Be more careful with at least the affinity call; someone may use an
  affinity-compiled version on a non-affinity kernel.
@@ -660,6 +1341,8 @@ void print_process(pid_t pid)
 	int policy, nice;
 	struct sched_param p;
 	cpu_set_t aff_mask;
+	unsigned long long cookie;
+	struct sched_attr_s attr;
 	CPUSET_HEXSTRING(aff_mask_hex);
 
 
@@ -694,6 +1377,13 @@ void print_process(pid_t pid)
 			      );
 		}
 
+		/* the effective EEVDF slice; 0 on kernels without custom slices */
+		if(IS_FAIR_POLICY(policy)
+		   && ! sched_getattr_s(pid, &attr)
+		   && attr.sched_runtime) {
+			printf(", SLICE %llu us", attr.sched_runtime / 1000);
+		}
+
 		/*
 		 sched_getaffinity() seems to also return (int)4 on 2.6.8+ on x86 when successful.
 		 this goes against the documentation
@@ -706,7 +1396,14 @@ void print_process(pid_t pid)
                         errno=0;
 		} else {
 			printf(", AFFINITY 0x%s", cpuset_to_str(&aff_mask, aff_mask_hex));
+			print_core_types(&aff_mask);
+		}
+
+		/* only tasks with a cookie are restricted in sharing a core */
+		if(! get_core_cookie(pid, &cookie) && cookie) {
+			printf(", COOKIE 0x%llx", cookie);
 		}
+		errno=0;
 	printf("\n");
 	}
 }
@@ -732,7 +1429,24 @@ void usage(void)
                "    -p STATIC_PRIORITY    usually 1-99; only for FIFO or RR\n" \
                "                          higher numbers means higher priority\n" \
                "    -n NICE_LEVEL         set niceness to NICE_LEVEL\n" \
-               "    -a AFFINITY_MASK      set CPU-affinity to bitmask or list\n\n" \
+               "    -s SLICE              request a SLICE us time slice (100-100000);\n" \
+               "                          only NORMAL/BATCH, linux 6.12+\n" \
+               "    -a AFFINITY_MASK      set CPU-affinity to bitmask or list of CPUs, ranges\n" \
+               "                          and isolated, nohz_full, housekeeping, online,\n" \
+               "                          pcore, ecore, capacity>=N\n" \
+               "    -t                    transactional: roll back a PID if any setting fails\n" \
+               "    -T                    like -t, but all-or-nothing across all PIDs\n" \
+               "    -P PROFILE[,PROFILE]  use settings of named profiles; see schedtool(8)\n" \
+               "    -S                    strict: refuse instead of warn about questionable\n" \
+               "                          affinities (offline, isolation, cpuset)\n" \
+               "    -m                    set affinity to the NUMA node holding most memory\n" \
+               "    -d                    dry run: report and check only, change nothing\n" \
+               "    -b MS[,OPTIONS]       rebalance pinned threads of PIDs every MS among\n" \
+               "                          the CPUs of -a; see schedtool(8) for OPTIONS\n" \
+               "    -w PERCENT[,OPTIONS]  demote RT tasks of PIDs (or all) using more than\n" \
+               "                          PERCENT CPU per window; see schedtool(8)\n" \
+               "    -c new|group|share=PID|clear[,scope=thread|process|pgroup]\n" \
+               "                          manage core scheduling cookies (SMT isolation)\n\n" \
                "    -e COMMAND [ARGS]     start COMMAND with specified policy/priority\n" \
                "    -r                    display priority min/max for each policy\n" \
                "    -v                    be verbose\n" \
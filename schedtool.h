@@ -0,0 +1,85 @@
+/*
+ Schedtool
+ (c) by Freek <email_undisclosed>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation version 2 of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ Please see the file LICENSE for details.
+
+ */
+
+/*
+ definitions shared between schedtool.c and the other modules;
+ include after <sched.h> so the SCHED_* below win
+ */
+
+/*
+ constants are from the O(1)-sched kernel's include/sched.h
+ I don't want to include kernel-headers.
+ Included those defines for improved readability.
+ */
+#undef SCHED_NORMAL
+#undef SCHED_FIFO
+#undef SCHED_RR
+#undef SCHED_BATCH
+#undef SCHED_DEADLINE
+#define SCHED_NORMAL	0
+#define SCHED_FIFO	1
+#define SCHED_RR	2
+#define SCHED_BATCH	3
+#define SCHED_ISO	4
+#define SCHED_IDLEPRIO	5
+/* not settable via sched_setscheduler(), but may show up as raw policy */
+#define SCHED_DEADLINE	6
+
+#ifndef SCHED_RESET_ON_FORK
+#define SCHED_RESET_ON_FORK	0x40000000
+#endif
+
+/* for loops */
+#define SCHED_MIN SCHED_NORMAL
+#define SCHED_MAX SCHED_IDLEPRIO
+
+#define IS_RT_POLICY(p) (p == SCHED_FIFO || p == SCHED_RR || p == SCHED_ISO \
+			 || p == SCHED_DEADLINE)
+#define IS_FAIR_POLICY(p) (p == SCHED_NORMAL || p == SCHED_BATCH)
+#define CHECK_RANGE_POLICY(p) (p <= SCHED_MAX && p >= SCHED_MIN)
+#define CHECK_RANGE_NICE(n) (n <= 20 && n >= -20)
+#define CHECK_RANGE_PRIO(p, p_low, p_high) (p <= (p_high) && p >= (p_low))
+
+/* the kernel clamps custom slices of fair tasks to this, in us */
+#define SLICE_MIN	100
+#define SLICE_MAX	100000
+#define CHECK_RANGE_SLICE(s) (s <= SLICE_MAX && s >= SLICE_MIN)
+
+/*
+ struct sched_attr (SCHED_ATTR_SIZE_VER0) of the kernel's
+ include/uapi/linux/sched/types.h; glibc only has it since 2.41.
+ For SCHED_NORMAL/BATCH, sched_runtime is the slice in ns (linux 6.12+).
+ */
+struct sched_attr_s {
+	unsigned int size;
+	unsigned int sched_policy;
+	unsigned long long sched_flags;
+	int sched_nice;
+	unsigned int sched_priority;
+	unsigned long long sched_runtime;
+	unsigned long long sched_deadline;
+	unsigned long long sched_period;
+};
+#define SCHED_FLAG_RESET_ON_FORK	0x01
+
+/* "N: SCHED_NORMAL" and so on, indexed by policy */
+extern char *TAB[];
+
+int set_process(pid_t pid, int policy, int prio, unsigned long long slice);
+int sched_getattr_s(pid_t pid, struct sched_attr_s *attr);
+int sched_setattr_s(pid_t pid, struct sched_attr_s *attr);
+void get_prio_min_max(int policy, int *min, int *max);
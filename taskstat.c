@@ -0,0 +1,225 @@
+/*
+ Schedtool
+ (c) by Freek <email_undisclosed>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation version 2 of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ Please see the file LICENSE for details.
+
+ */
+
+/*
+ Content:
+
+ sampling of per-thread and per-CPU statistics from /proc for the
+ periodic modes
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <time.h>
+#include <signal.h>
+#include <sys/types.h>
+
+#include "error.h"
+#include "taskstat.h"
+
+/* the flags field of /proc/PID/stat, see linux/sched.h */
+#define PF_KTHREAD	0x00200000
+
+static volatile sig_atomic_t stop;
+
+
+/* returns -1 if the thread is gone or the kernel lacks schedstats */
+int read_schedstat(pid_t pid, pid_t tid, struct schedstat_s *st)
+{
+	FILE *f;
+	char path[64];
+	int ret=-1;
+
+	snprintf(path, sizeof(path), "/proc/%d/task/%d/schedstat", pid, tid);
+	if((f=fopen(path, "r"))) {
+		if(fscanf(f, "%llu %llu %llu", &(st->run), &(st->wait), &(st->slices)) == 3) {
+			ret=0;
+		}
+		fclose(f);
+	}
+	return(ret);
+}
+
+
+static int cmp_pid(const void *a, const void *b)
+{
+	return(*(const pid_t *)a - *(const pid_t *)b);
+}
+
+
+/*
+ all thread IDs of pid, sorted, in a malloc()ed array; returns their
+ number or -1 if the process is gone
+ */
+int get_threads(pid_t pid, pid_t **tids)
+{
+	DIR *dir;
+	struct dirent *d;
+	char path[64];
+	pid_t *t=NULL, *tmp;
+	int n=0, size=0;
+
+	snprintf(path, sizeof(path), "/proc/%d/task", pid);
+	if(! (dir=opendir(path))) {
+		return(-1);
+	}
+
+	while((d=readdir(dir))) {
+		if(! isdigit((int)*(d->d_name))) {
+			continue;
+		}
+		if(n == size) {
+			size=(size ? size * 2 : 16);
+			if(! (tmp=realloc(t, size * sizeof(*t)))) {
+				break;
+			}
+			t=tmp;
+		}
+		t[n++]=atoi(d->d_name);
+	}
+	closedir(dir);
+
+	qsort(t, n, sizeof(*t), cmp_pid);
+	*tids=t;
+	return(n);
+}
+
+
+/*
+ fill stat[0..n-1] from the cpuN lines of /proc/stat; CPUs not listed
+ (offline) are zeroed. Returns -1 if /proc/stat can't be read.
+ */
+int read_cpustat(struct cpustat_s *stat, int n)
+{
+	FILE *f;
+	char buf[512];
+
+	memset(stat, 0, n * sizeof(*stat));
+
+	if(! (f=fopen("/proc/stat", "r"))) {
+		return(-1);
+	}
+
+	while(fgets(buf, sizeof(buf), f)) {
+		unsigned long long user, nice, sys, idle, iowait, irq, softirq, steal;
+		int cpu;
+
+		if(strncmp(buf, "cpu", 3) || ! isdigit((int)buf[3])) {
+			continue;
+		}
+		steal=0;
+		if(sscanf(buf + 3, "%d %llu %llu %llu %llu %llu %llu %llu %llu",
+			  &cpu, &user, &nice, &sys, &idle, &iowait, &irq, &softirq, &steal) < 8
+		   || cpu < 0 || cpu >= n) {
+			continue;
+		}
+		stat[cpu].busy=user + nice + sys + irq + softirq + steal;
+		stat[cpu].total=stat[cpu].busy + idle + iowait;
+	}
+	fclose(f);
+	return(0);
+}
+
+
+/* the comm of a thread (tid == pid for the process), "?" if it's gone */
+char * get_comm(pid_t pid, pid_t tid, char *comm, size_t len)
+{
+	FILE *f;
+	char path[64];
+
+	snprintf(path, sizeof(path), "/proc/%d/task/%d/comm", pid, tid);
+	strncpy(comm, "?", len);
+	if((f=fopen(path, "r"))) {
+		if(fgets(comm, len, f)) {
+			comm[strcspn(comm, "\n")]=0;
+		}
+		fclose(f);
+	}
+	return(comm);
+}
+
+
+/*
+ kernel threads have PF_KTHREAD in field 9 of /proc/PID/stat; the comm
+ before it may contain anything, so start after its closing paren
+ */
+int is_kernel_thread(pid_t pid)
+{
+	FILE *f;
+	char path[64], buf[512], *p;
+	unsigned int flags=0;
+
+	snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+	if(! (f=fopen(path, "r"))) {
+		return(0);
+	}
+	if(fgets(buf, sizeof(buf), f) && (p=strrchr(buf, ')'))) {
+		sscanf(p + 1, " %*c %*d %*d %*d %*d %*d %u", &flags);
+	}
+	fclose(f);
+	return((flags & PF_KTHREAD) != 0);
+}
+
+
+/* the periodic modes run until SIGINT/SIGTERM and then clean up */
+static void stop_handler(int sig)
+{
+	(void)sig;
+	stop=1;
+}
+
+
+void catch_stop_signals(void)
+{
+	struct sigaction sa;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler=stop_handler;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+}
+
+
+int stop_requested(void)
+{
+	return(stop);
+}
+
+
+unsigned long long now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return(ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000);
+}
+
+
+/* returns -1 if interrupted by a signal */
+int sleep_ms(long ms)
+{
+	struct timespec ts;
+
+	ts.tv_sec=ms / 1000;
+	ts.tv_nsec=(ms % 1000) * 1000000L;
+	return(nanosleep(&ts, NULL) ? -1 : 0);
+}
@@ -0,0 +1,39 @@
+/*
+ Schedtool
+ (c) by Freek <email_undisclosed>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation version 2 of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ Please see the file LICENSE for details.
+
+ */
+
+/* /proc/PID/task/TID/schedstat, all in ns */
+struct schedstat_s {
+	unsigned long long run;
+	unsigned long long wait;
+	unsigned long long slices;
+};
+
+/* busy and total time of a CPU from /proc/stat, in USER_HZ */
+struct cpustat_s {
+	unsigned long long busy;
+	unsigned long long total;
+};
+
+int read_schedstat(pid_t pid, pid_t tid, struct schedstat_s *st);
+int get_threads(pid_t pid, pid_t **tids);
+int read_cpustat(struct cpustat_s *stat, int n);
+char * get_comm(pid_t pid, pid_t tid, char *comm, size_t len);
+int is_kernel_thread(pid_t pid);
+int sleep_ms(long ms);
+unsigned long long now_ms(void);
+void catch_stop_signals(void);
+int stop_requested(void);
@@ -0,0 +1,360 @@
+/*
+ Schedtool
+ (c) by Freek <email_undisclosed>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation version 2 of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ Please see the file LICENSE for details.
+
+ */
+
+/*
+ Content:
+
+ end-to-end harness: spawn N idle threads and run the schedtool binary
+ on all of them, measuring tasks per second for setting policy, setting
+ affinity and querying. With -c, every run is also checked: exit status,
+ the settings of each thread and one line of output per queried thread,
+ and -t/-T have to roll back all threads when a setting fails.
+
+ USAGE: bench_apply [-c] [-n THREADS] [-r ROUNDS] SCHEDTOOL
+ run by make check (-c, few threads) and make bench
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+
+#include "../parse.h"
+
+static pid_t *tids;
+static int n_started;
+static pthread_mutex_t lock=PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t started=PTHREAD_COND_INITIALIZER;
+
+/* the idle threads block on reading this until the end */
+static int idle_pipe[2];
+
+static int check, failures;
+
+
+static void *idle_thread(void *arg)
+{
+	char c;
+
+	(void)arg;
+	pthread_mutex_lock(&lock);
+	tids[n_started++]=syscall(SYS_gettid);
+	pthread_cond_signal(&started);
+	pthread_mutex_unlock(&lock);
+
+	while(read(idle_pipe[0], &c, 1) < 0)
+		;
+	return(NULL);
+}
+
+
+static double now_s(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return(ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+
+/*
+ run schedtool with opts (NULL terminated), all TIDs and last (if not NULL);
+ returns its exit status and the # of output lines starting with prefix
+ (all lines if NULL)
+ */
+static int run(const char *schedtool, const char **opts, const char *last,
+	       const char *prefix, int n, int *lines)
+{
+	char **argv, *buf, c[4096];
+	int i, argc=0, status, out[2], col=0, match=1;
+	ssize_t len;
+	pid_t child;
+
+	argv=malloc((n + 16) * sizeof(char *));
+	buf=malloc(n * 16);
+	argv[argc++]=(char *)schedtool;
+	for(; *opts; opts++) {
+		argv[argc++]=(char *)*opts;
+	}
+	for(i=0; i < n; i++) {
+		argv[argc]=buf + i * 16;
+		snprintf(argv[argc++], 16, "%d", tids[i]);
+	}
+	if(last) {
+		argv[argc++]=(char *)last;
+	}
+	argv[argc]=NULL;
+
+	if(pipe(out) || (child=fork()) < 0) {
+		perror("bench_apply");
+		exit(1);
+	}
+	if(! child) {
+		dup2(out[1], STDOUT_FILENO);
+		close(out[0]);
+		close(out[1]);
+		execv(schedtool, argv);
+		perror(schedtool);
+		_exit(127);
+	}
+	close(out[1]);
+
+	*lines=0;
+	while((len=read(out[0], c, sizeof(c))) > 0) {
+		for(i=0; i < len; i++) {
+			if(c[i] == '\n') {
+				*lines += match;
+				col=0;
+				match=1;
+				continue;
+			}
+			if(prefix && col < (int)strlen(prefix) && c[i] != prefix[col]) {
+				match=0;
+			}
+			col++;
+		}
+	}
+	close(out[0]);
+	waitpid(child, &status, 0);
+
+	free(argv);
+	free(buf);
+	return(WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+}
+
+
+static void fail(const char *what, int round, const char *why, int val)
+{
+	fprintf(stderr, "bench_apply: %s, round %d: %s %d\n", what, round, why, val);
+	failures++;
+}
+
+
+static void bench_policy(const char *schedtool, int n, int rounds)
+{
+	static const char *batch[]={ "-B", NULL }, *normal[]={ "-N", NULL };
+	int r, i, ret, lines, policy;
+	double start=now_s();
+
+	for(r=0; r < rounds; r++) {
+		/* alternate, so there's something to change each time */
+		ret=run(schedtool, (r % 2) ? normal : batch, NULL, NULL, n, &lines);
+		if(! check) {
+			continue;
+		}
+		if(ret) {
+			fail("policy", r, "exit status", ret);
+		}
+		for(i=0; i < n; i++) {
+			policy=sched_getscheduler(tids[i]);
+			if(policy != ((r % 2) ? SCHED_OTHER : SCHED_BATCH)) {
+				fail("policy", r, "wrong policy", policy);
+				break;
+			}
+		}
+	}
+	printf("%-16s %6d tasks x %3d rounds: %10.0f tasks/s\n",
+	       "set policy", n, rounds, n * rounds / (now_s() - start));
+}
+
+
+static void bench_affinity(const char *schedtool, int n, int rounds)
+{
+	const char *opts[]={ "-a", NULL, NULL };
+	cpu_set_t all, mask;
+	CPUSET_HEXSTRING(hex);
+	char str[CPU_SETSIZE / 2 + 8];
+	int r, i, ret, lines;
+	double start;
+
+	/* whatever we may run on, so the threads end up as they began */
+	sched_getaffinity(0, sizeof(all), &all);
+	snprintf(str, sizeof(str), "0x%s", cpuset_to_str(&all, hex));
+	opts[1]=str;
+
+	start=now_s();
+	for(r=0; r < rounds; r++) {
+		ret=run(schedtool, opts, NULL, NULL, n, &lines);
+		if(! check) {
+			continue;
+		}
+		if(ret) {
+			fail("affinity", r, "exit status", ret);
+		}
+		for(i=0; i < n; i++) {
+			if(sched_getaffinity(tids[i], sizeof(mask), &mask) || ! CPU_EQUAL(&mask, &all)) {
+				fail("affinity", r, "wrong affinity of TID", tids[i]);
+				break;
+			}
+		}
+	}
+	printf("%-16s %6d tasks x %3d rounds: %10.0f tasks/s\n",
+	       "set affinity", n, rounds, n * rounds / (now_s() - start));
+}
+
+
+static void bench_query(const char *schedtool, int n, int rounds)
+{
+	static const char *none[]={ NULL };
+	int r, ret, lines;
+	double start=now_s();
+
+	for(r=0; r < rounds; r++) {
+		ret=run(schedtool, none, NULL, NULL, n, &lines);
+		if(! check) {
+			continue;
+		}
+		if(ret) {
+			fail("query", r, "exit status", ret);
+		}
+		if(lines != n) {
+			fail("query", r, "output lines", lines);
+		}
+	}
+	printf("%-16s %6d tasks x %3d rounds: %10.0f tasks/s\n",
+	       "query", n, rounds, n * rounds / (now_s() - start));
+}
+
+
+/*
+ -t: setting the affinity to a CPU which doesn't exist fails for each
+ thread, after the policy has been set already
+ -T: a PID beyond pid_max fails after all threads have been set
+ either way, all threads have to end up as they were, with a ROLLBACK line
+ */
+static void check_rollback(const char *schedtool, int n)
+{
+	static const char *transact[]={ "-t", "-B", "-a", "1023", NULL };
+	static const char *all_or_nothing[]={ "-T", "-B", NULL };
+	int i, ret, lines, policy;
+	char bad_pid[16];
+
+	snprintf(bad_pid, sizeof(bad_pid), "%d", 0x7fffffff);
+
+	/* the threads have to be SCHED_NORMAL for the rollback to be visible */
+	if(run(schedtool, (const char *[]){ "-N", NULL }, NULL, NULL, n, &lines)) {
+		fail("rollback", 0, "can't set up SCHED_NORMAL, exit status", 1);
+		return;
+	}
+
+	ret=run(schedtool, transact, NULL, "ROLLBACK:", n, &lines);
+	if(! ret) {
+		fail("-t rollback", 0, "exit status", ret);
+	}
+	if(lines != n) {
+		fail("-t rollback", 0, "ROLLBACK lines", lines);
+	}
+	for(i=0; i < n; i++) {
+		if((policy=sched_getscheduler(tids[i])) != SCHED_OTHER) {
+			fail("-t rollback", 0, "policy not restored", policy);
+			break;
+		}
+	}
+
+	ret=run(schedtool, all_or_nothing, bad_pid, "ROLLBACK:", n, &lines);
+	if(! ret) {
+		fail("-T rollback", 0, "exit status", ret);
+	}
+	if(lines != n) {
+		fail("-T rollback", 0, "ROLLBACK lines", lines);
+	}
+	for(i=0; i < n; i++) {
+		if((policy=sched_getscheduler(tids[i])) != SCHED_OTHER) {
+			fail("-T rollback", 0, "policy not restored", policy);
+			break;
+		}
+	}
+}
+
+
+int main(int ac, char **dc)
+{
+	int c, i, n=1000, rounds=10;
+	pthread_t *threads;
+	pthread_attr_t attr;
+
+	while((c=getopt(ac, dc, "cn:r:")) != -1) {
+		switch(c) {
+		case 'c':
+			check=1;
+			break;
+		case 'n':
+			n=atoi(optarg);
+			break;
+		case 'r':
+			rounds=atoi(optarg);
+			break;
+		default:
+			optind=ac;
+			break;
+		}
+	}
+	if(optind != ac - 1 || n < 1 || rounds < 1) {
+		fprintf(stderr, "USAGE: bench_apply [-c] [-n THREADS] [-r ROUNDS] SCHEDTOOL\n");
+		return(1);
+	}
+
+	tids=calloc(n, sizeof(pid_t));
+	threads=calloc(n, sizeof(pthread_t));
+	if(! tids || ! threads || pipe(idle_pipe)) {
+		perror("bench_apply");
+		return(1);
+	}
+
+	/* idle threads don't need much of a stack */
+	pthread_attr_init(&attr);
+	pthread_attr_setstacksize(&attr, 64 * 1024);
+	for(i=0; i < n; i++) {
+		if(pthread_create(&threads[i], &attr, idle_thread, NULL)) {
+			fprintf(stderr, "bench_apply: could only start %d threads\n", i);
+			return(1);
+		}
+	}
+
+	pthread_mutex_lock(&lock);
+	while(n_started < n) {
+		pthread_cond_wait(&started, &lock);
+	}
+	pthread_mutex_unlock(&lock);
+
+	bench_policy(dc[optind], n, rounds);
+	bench_affinity(dc[optind], n, rounds);
+	bench_query(dc[optind], n, rounds);
+	if(check) {
+		check_rollback(dc[optind], n);
+	}
+
+	/* EOF wakes them all */
+	close(idle_pipe[1]);
+	for(i=0; i < n; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	if(check) {
+		fflush(stdout);
+		fprintf(stderr, "bench_apply: %d failures\n", failures);
+	}
+	return(failures ? 1 : 0);
+}
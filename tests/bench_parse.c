@@ -0,0 +1,157 @@
+/*
+ Schedtool
+ (c) by Freek <email_undisclosed>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation version 2 of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ Please see the file LICENSE for details.
+
+ */
+
+/*
+ Content:
+
+ microbenchmark of parse.c: ns per parse/format of typical masks
+
+ USAGE: bench_parse [ITERATIONS]
+ run by make bench
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sched.h>
+
+#include "../error.h"
+#include "../topology.h"
+#include "../parse.h"
+
+/* keeps the compiler from dropping the loops */
+static volatile int sink;
+
+
+static double now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return(ts.tv_sec * 1e9 + ts.tv_nsec);
+}
+
+
+static void report(const char *what, const char *arg, double start, int iterations)
+{
+	printf("%-18s %-24s %10.1f ns/op\n", what, arg, (now_ns() - start) / iterations);
+}
+
+
+static void bench_str_to_cpuset(const char *str, int iterations)
+{
+	cpu_set_t mask;
+	double start=now_ns();
+	int i;
+
+	for(i=0; i < iterations; i++) {
+		sink += str_to_cpuset(&mask, str);
+	}
+	report("str_to_cpuset", str, start, iterations);
+}
+
+
+static void bench_parse_affinity(const char *str, int iterations)
+{
+	cpu_set_t mask;
+	double start=now_ns();
+	int i;
+
+	for(i=0; i < iterations; i++) {
+		sink += parse_affinity(&mask, str);
+	}
+	report("parse_affinity", str, start, iterations);
+}
+
+
+static void bench_cpuset_to_str(const char *str, int iterations)
+{
+	cpu_set_t mask;
+	CPUSET_HEXSTRING(hex);
+	double start;
+	int i;
+
+	str_to_cpuset(&mask, str);
+	start=now_ns();
+	for(i=0; i < iterations; i++) {
+		sink += *cpuset_to_str(&mask, hex);
+	}
+	report("cpuset_to_str", str, start, iterations);
+}
+
+
+static void bench_cpuset_to_cpulist(const char *str, int iterations)
+{
+	cpu_set_t mask;
+	char list[CPU_SETSIZE * 4];
+	double start;
+	int i;
+
+	str_to_cpuset(&mask, str);
+	start=now_ns();
+	for(i=0; i < iterations; i++) {
+		sink += *cpuset_to_cpulist(&mask, list, sizeof(list));
+	}
+	report("cpuset_to_cpulist", str, start, iterations);
+}
+
+
+static void bench_parse_int(const char *str, int iterations)
+{
+	double start=now_ns();
+	int i, val;
+
+	for(i=0; i < iterations; i++) {
+		sink += parse_int(str, &val);
+	}
+	report("parse_int", str, start, iterations);
+}
+
+
+int main(int ac, char **dc)
+{
+	int iterations=ac > 1 ? atoi(dc[1]) : 1000000;
+	static const char *masks[]={ "0x1", "0xff00ff", "0xffffffffffffffff", 0 };
+	static const char *lists[]={ "3", "0-7,16-23", "0,2,4,6,8,10,12,14", "0-1023", 0 };
+	int i;
+
+	if(iterations < 1) {
+		iterations=1;
+	}
+
+	for(i=0; masks[i]; i++) {
+		bench_str_to_cpuset(masks[i], iterations);
+	}
+	for(i=0; masks[i]; i++) {
+		bench_cpuset_to_str(masks[i], iterations);
+	}
+	for(i=0; masks[i]; i++) {
+		bench_cpuset_to_cpulist(masks[i], iterations);
+	}
+	for(i=0; masks[i]; i++) {
+		bench_parse_affinity(masks[i], iterations);
+	}
+	for(i=0; lists[i]; i++) {
+		bench_parse_affinity(lists[i], iterations);
+	}
+	bench_parse_int("4711", iterations);
+	return(0);
+}
@@ -0,0 +1,33 @@
+/*
+ Schedtool
+ (c) by Freek <email_undisclosed>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation version 2 of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ Please see the file LICENSE for details.
+
+ */
+
+/*
+ the check macro of the unit tests; each test reports checks and
+ failures at the end and exits non-zero if anything failed
+ */
+
+static int checks, failures;
+
+#define CHECK(cond, ...) do { \
+		checks++; \
+		if(! (cond)) { \
+			failures++; \
+			fprintf(stderr, "%s:%d: FAILED %s: ", __FILE__, __LINE__, #cond); \
+			fprintf(stderr, __VA_ARGS__); \
+			fprintf(stderr, "\n"); \
+		} \
+	} while(0)
@@ -0,0 +1,324 @@
+/*
+ Schedtool
+ (c) by Freek <email_undisclosed>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation version 2 of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ Please see the file LICENSE for details.
+
+ */
+
+/*
+ Content:
+
+ unit and fuzz tests for parse.c: integers, hex masks, affinity lists
+ and their round-trips through cpuset_to_str() / cpuset_to_cpulist()
+
+ USAGE: test_parse [ITERATIONS [SEED]]
+ run by make check; the ERROR: lines of the parsers go to stdout, which
+ is discarded, results go to stderr
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <sched.h>
+
+#include "../error.h"
+#include "../topology.h"
+#include "../parse.h"
+#include "check.h"
+
+
+/* CPUs from a -1 terminated list */
+static void make_set(cpu_set_t *mask, const int *cpus)
+{
+	CPU_ZERO(mask);
+	for(; *cpus >= 0; cpus++) {
+		CPU_SET(*cpus, mask);
+	}
+}
+
+
+/* parse_affinity(), which has to leave its argument whole for error messages */
+static int affinity(const char *str, cpu_set_t *mask)
+{
+	char buf[4096];
+	int ret;
+
+	snprintf(buf, sizeof(buf), "%s", str);
+	ret=parse_affinity(mask, buf);
+	CHECK(! strcmp(buf, str), "%s changed to %s", str, buf);
+	return(ret);
+}
+
+
+static void test_parse_int(void)
+{
+	int val;
+	char buf[32];
+
+	CHECK(! parse_int("12", &val) && val == 12, "12");
+	CHECK(! parse_int("-5", &val) && val == -5, "-5");
+	CHECK(! parse_int("+7", &val) && val == 7, "+7");
+	/* decimal like atoi(), not octal */
+	CHECK(! parse_int("010", &val) && val == 10, "010 -> %d", val);
+
+	CHECK(parse_int("", &val), "empty string");
+	CHECK(parse_int("abc", &val), "abc");
+	CHECK(parse_int("12abc", &val), "12abc, atoi() would take 12");
+	CHECK(parse_int("12 ", &val), "trailing blank");
+	CHECK(parse_int("0x10", &val), "0x10");
+	CHECK(parse_int("99999999999", &val), "overflow");
+
+	snprintf(buf, sizeof(buf), "%d", INT_MAX);
+	CHECK(! parse_int(buf, &val) && val == INT_MAX, "INT_MAX");
+	snprintf(buf, sizeof(buf), "%d", INT_MIN);
+	CHECK(! parse_int(buf, &val) && val == INT_MIN, "INT_MIN");
+}
+
+
+static void test_parse_pid(void)
+{
+	pid_t pid;
+
+	CHECK(! parse_pid("4711", &pid) && pid == 4711, "4711");
+	CHECK(! parse_pid("0", &pid) && pid == 0, "0");
+	CHECK(parse_pid("-1", &pid), "-1");
+	CHECK(parse_pid("12abc", &pid), "12abc");
+	CHECK(parse_pid("", &pid), "empty string");
+	CHECK(parse_pid(" 1", &pid), "leading blank");
+}
+
+
+static void test_str_to_cpuset(void)
+{
+	cpu_set_t mask, expect;
+	char buf[CPU_SETSIZE / 4 + 8];
+	static const int cpu0[]={0, -1}, cpu01[]={0, 1, -1}, cpu8[]={8, -1};
+	static const int cpu0_7[]={0, 1, 2, 3, 4, 5, 6, 7, -1};
+	static const int cpu_last[]={CPU_SETSIZE - 1, -1};
+
+	make_set(&expect, cpu0);
+	CHECK(! str_to_cpuset(&mask, "0x1") && CPU_EQUAL(&mask, &expect), "0x1");
+	CHECK(! str_to_cpuset(&mask, "1") && CPU_EQUAL(&mask, &expect), "1");
+	CHECK(! str_to_cpuset(&mask, "0x0001") && CPU_EQUAL(&mask, &expect), "0x0001");
+
+	make_set(&expect, cpu01);
+	CHECK(! str_to_cpuset(&mask, "0X3") && CPU_EQUAL(&mask, &expect), "0X3");
+
+	make_set(&expect, cpu0_7);
+	CHECK(! str_to_cpuset(&mask, "0xFf") && CPU_EQUAL(&mask, &expect), "0xFf");
+
+	make_set(&expect, cpu8);
+	CHECK(! str_to_cpuset(&mask, "0x100") && CPU_EQUAL(&mask, &expect), "0x100");
+
+	/* the prefix alone is no mask */
+	CHECK(str_to_cpuset(&mask, "0x"), "0x");
+	CHECK(str_to_cpuset(&mask, ""), "empty string");
+	CHECK(str_to_cpuset(&mask, "0xg"), "0xg");
+	CHECK(str_to_cpuset(&mask, "1g"), "1g");
+	CHECK(str_to_cpuset(&mask, "0x0x1"), "0x0x1");
+	CHECK(str_to_cpuset(&mask, "x1"), "x1");
+
+	/* exactly CPU_SETSIZE bits, then one more */
+	memset(buf, '0', CPU_SETSIZE / 4);
+	buf[0]='8';
+	buf[CPU_SETSIZE / 4]=0;
+	make_set(&expect, cpu_last);
+	CHECK(! str_to_cpuset(&mask, buf) && CPU_EQUAL(&mask, &expect), "highest CPU");
+
+	memset(buf, '0', CPU_SETSIZE / 4 + 1);
+	buf[0]='1';
+	buf[CPU_SETSIZE / 4 + 1]=0;
+	CHECK(str_to_cpuset(&mask, buf), "CPU beyond CPU_SETSIZE");
+
+	/* leading zeroes beyond it are fine */
+	memset(buf, '0', CPU_SETSIZE / 4 + 4);
+	buf[CPU_SETSIZE / 4 + 3]='1';
+	buf[CPU_SETSIZE / 4 + 4]=0;
+	make_set(&expect, cpu0);
+	CHECK(! str_to_cpuset(&mask, buf) && CPU_EQUAL(&mask, &expect), "leading zeroes");
+}
+
+
+static void test_cpuset_to_str(void)
+{
+	cpu_set_t mask;
+	CPUSET_HEXSTRING(hex);
+	char *str;
+	static const int cpu0[]={0, -1}, cpu4[]={4, -1}, cpu0_9[]={0, 9, -1};
+	static const int cpu_last[]={CPU_SETSIZE - 1, -1};
+
+	CPU_ZERO(&mask);
+	CHECK(! strcmp(str=cpuset_to_str(&mask, hex), "0"), "empty -> %s", str);
+
+	make_set(&mask, cpu0);
+	CHECK(! strcmp(str=cpuset_to_str(&mask, hex), "1"), "0 -> %s", str);
+
+	make_set(&mask, cpu4);
+	CHECK(! strcmp(str=cpuset_to_str(&mask, hex), "10"), "4 -> %s", str);
+
+	make_set(&mask, cpu0_9);
+	CHECK(! strcmp(str=cpuset_to_str(&mask, hex), "201"), "0,9 -> %s", str);
+
+	make_set(&mask, cpu_last);
+	str=cpuset_to_str(&mask, hex);
+	CHECK(strlen(str) == CPU_SETSIZE / 4 && str[0] == '8'
+	      && strspn(str + 1, "0") == CPU_SETSIZE / 4 - 1, "highest CPU -> %s", str);
+}
+
+
+static void test_parse_affinity(void)
+{
+	cpu_set_t mask, expect, online;
+	static const int cpu02[]={0, 2, -1}, cpu1_3[]={1, 2, 3, -1};
+	static const int cpu1_3_8[]={1, 2, 3, 8, -1};
+
+	make_set(&expect, cpu02);
+	CHECK(! affinity("0x5", &mask) && CPU_EQUAL(&mask, &expect), "0x5");
+	CHECK(! affinity("0,2", &mask) && CPU_EQUAL(&mask, &expect), "0,2");
+	CHECK(! affinity("0.2", &mask) && CPU_EQUAL(&mask, &expect), "0.2");
+	CHECK(! affinity("2,0,2", &mask) && CPU_EQUAL(&mask, &expect), "2,0,2");
+
+	make_set(&expect, cpu1_3);
+	CHECK(! affinity("1-3", &mask) && CPU_EQUAL(&mask, &expect), "1-3");
+
+	make_set(&expect, cpu1_3_8);
+	CHECK(! affinity("1-3,8", &mask) && CPU_EQUAL(&mask, &expect), "1-3,8");
+	CHECK(! affinity("0x10e", &mask) && CPU_EQUAL(&mask, &expect), "0x10e");
+
+	/* hex errors used to be ignored, leaving a partial or empty mask */
+	CHECK(affinity("0x", &mask), "0x");
+	CHECK(affinity("0x0", &mask), "0x0");
+	CHECK(affinity("0xz1", &mask), "0xz1");
+	CHECK(affinity("0x1,2", &mask), "0x1,2");
+
+	CHECK(affinity("", &mask), "empty string");
+	CHECK(affinity(",,", &mask), ",,");
+	CHECK(affinity("3-1", &mask), "3-1");
+	CHECK(affinity("1-", &mask), "1-");
+	CHECK(affinity("1x", &mask), "1x");
+	CHECK(affinity("foo", &mask), "foo");
+	CHECK(affinity("capacity>=", &mask), "capacity>=");
+
+	get_online_cpus(&online);
+	CHECK(! affinity("online", &mask) && CPU_EQUAL(&mask, &online), "online");
+}
+
+
+/* random mask, sometimes sparse, sometimes dense, sometimes high CPUs only */
+static void random_mask(cpu_set_t *mask)
+{
+	int i, n, range;
+
+	CPU_ZERO(mask);
+	range=(rand() % 2) ? 64 : CPU_SETSIZE;
+	n=1 + rand() % ((rand() % 4) ? 8 : range);
+
+	for(i=0; i < n; i++) {
+		CPU_SET(rand() % range, mask);
+	}
+}
+
+
+/* format -> parse has to give the same mask, in hex and in list mode */
+static void fuzz_round_trip(int iterations)
+{
+	cpu_set_t mask, back;
+	CPUSET_HEXSTRING(hex);
+	char str[CPU_SETSIZE / 2 + 8], list[CPU_SETSIZE * 4];
+	int i;
+
+	for(i=0; i < iterations; i++) {
+		random_mask(&mask);
+
+		snprintf(str, sizeof(str), "0x%s", cpuset_to_str(&mask, hex));
+		CHECK(! str_to_cpuset(&back, str) && CPU_EQUAL(&mask, &back), "hex %s", str);
+		CHECK(! affinity(str, &back) && CPU_EQUAL(&mask, &back), "affinity %s", str);
+
+		cpuset_to_cpulist(&mask, list, sizeof(list));
+		CHECK(! affinity(list, &back) && CPU_EQUAL(&mask, &back), "list %s", list);
+	}
+}
+
+
+/*
+ random junk must not crash, and whatever is accepted has to survive a
+ round-trip; parse_int() has to agree with strtol()
+ */
+static void fuzz_garbage(int iterations)
+{
+	static const char alphabet[]="0123456789abcdefABCDEFxX,.-+ >=";
+	cpu_set_t mask, back;
+	CPUSET_HEXSTRING(hex);
+	char str[64], again[CPU_SETSIZE / 2 + 8], *end;
+	int i, j, len, val;
+	long l;
+
+	for(i=0; i < iterations; i++) {
+		len=rand() % 24;
+		for(j=0; j < len; j++) {
+			/* mostly from the alphabet, sometimes any byte */
+			str[j]=(rand() % 8) ? alphabet[rand() % (sizeof(alphabet) - 1)]
+				: (char)(1 + rand() % 255);
+		}
+		str[len]=0;
+
+		if(! str_to_cpuset(&mask, str)) {
+			snprintf(again, sizeof(again), "0x%s", cpuset_to_str(&mask, hex));
+			CHECK(! str_to_cpuset(&back, again) && CPU_EQUAL(&mask, &back),
+			      "%s -> %s", str, again);
+		}
+
+		if(! affinity(str, &mask)) {
+			CHECK(CPU_COUNT(&mask) > 0, "%s accepted, but no CPUs", str);
+		}
+
+		errno=0;
+		l=strtol(str, &end, 10);
+		if(! parse_int(str, &val)) {
+			CHECK(! errno && ! *end && end != str && l == val, "%s -> %d", str, val);
+		} else {
+			CHECK(errno || *end || end == str || l != (int)l, "%s rejected", str);
+		}
+	}
+}
+
+
+int main(int ac, char **dc)
+{
+	int iterations=ac > 1 ? atoi(dc[1]) : 100000;
+	unsigned int seed=ac > 2 ? (unsigned int)atoi(dc[2]) : 4711;
+
+	/* decode_error() prints to stdout */
+	if(! freopen("/dev/null", "w", stdout)) {
+		perror("freopen");
+		return(1);
+	}
+
+	test_parse_int();
+	test_parse_pid();
+	test_str_to_cpuset();
+	test_cpuset_to_str();
+	test_parse_affinity();
+
+	srand(seed);
+	fuzz_round_trip(iterations);
+	fuzz_garbage(iterations);
+
+	fprintf(stderr, "test_parse: %d checks, %d failed (%d iterations, seed %u)\n",
+		checks, failures, iterations, seed);
+	return(failures ? 1 : 0);
+}
@@ -0,0 +1,91 @@
+/*
+ Schedtool
+ (c) by Freek <email_undisclosed>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation version 2 of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ Please see the file LICENSE for details.
+
+ */
+
+/*
+ Content:
+
+ unit tests for topology.c on synthetic capacity tables, so they don't
+ depend on the box they run on
+
+ USAGE: test_topology
+ run by make check
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sched.h>
+
+#include "../topology.h"
+#include "check.h"
+
+
+/* cpulist as string, for comparing */
+static const char *list(cpu_set_t *mask)
+{
+	static char str[2][CPU_SETSIZE * 4];
+	static int i;
+
+	i=! i;
+	return(cpuset_to_cpulist(mask, str[i], sizeof(str[i])));
+}
+
+
+/* split cap[0..n-1] and compare with the expected lists */
+static void check_split(const char *name, const int *cap, int n, int expect_ret,
+			const char *expect_p, const char *expect_e)
+{
+	cpu_set_t p, e;
+	int ret;
+
+	ret=split_core_types(cap, n, &p, &e);
+	CHECK(ret == expect_ret, "%s: returned %d", name, ret);
+	CHECK(! strcmp(list(&p), expect_p), "%s: P %s, expected %s", name, list(&p), expect_p);
+	CHECK(! strcmp(list(&e), expect_e), "%s: E %s, expected %s", name, list(&e), expect_e);
+}
+
+
+int main(void)
+{
+	/* Alder Lake from cpufreq: 8 P-cores 4.9/5.0 GHz, 8 E-cores 3.8 GHz */
+	static const int hybrid[]={ 1003, 1003, 1024, 1024, 1003, 1003, 1003, 1003,
+				    778, 778, 778, 778, 778, 778, 778, 778 };
+	/* Turbo Boost Max 3.0: two favoured cores at 5.3, the rest at 5.1 GHz */
+	static const int tbm3[]={ 985, 985, 1024, 985, 985, 1024, 985, 985 };
+	/* arm with three clusters from cpu_capacity: little, mid, big */
+	static const int dynamiq[]={ 160, 160, 160, 160, 870, 870, 870, 1024 };
+	static const int uniform[]={ 1024, 1024, 1024, 1024 };
+	/* offline or unknown CPUs are neither */
+	static const int holes[]={ 1024, -1, 400, -1 };
+	static const int unknown[]={ -1, -1 };
+	/* just at and just beyond the gap */
+	static const int edge[]={ 1000, 1000 - 10 * CORE_TYPE_GAP, 1000 - 10 * CORE_TYPE_GAP - 1 };
+
+	check_split("hybrid", hybrid, 16, 0, "0-7", "8-15");
+	check_split("tbm3", tbm3, 8, -1, "0-7", "");
+	check_split("dynamiq", dynamiq, 8, 0, "4-7", "0-3");
+	check_split("uniform", uniform, 4, -1, "0-3", "");
+	check_split("holes", holes, 4, 0, "0", "2");
+	check_split("unknown", unknown, 2, -1, "", "");
+	check_split("edge", edge, 3, 0, "0-1", "2");
+
+	fprintf(stderr, "test_topology: %d checks, %d failed\n", checks, failures);
+	return(failures ? 1 : 0);
+}
@@ -0,0 +1,452 @@
+/*
+ Schedtool
+ (c) by Freek <email_undisclosed>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation version 2 of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ Please see the file LICENSE for details.
+
+ */
+
+/*
+ Content:
+
+ reading CPU lists ("0-3,8") from sysfs/cgroupfs and resolving the
+ symbolic affinity tokens built from them
+ capacity and core type detection for hybrid (big/little) CPUs
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <sys/types.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "error.h"
+#include "topology.h"
+
+/*
+ capacity of each CPU scaled to CPU_CAPACITY_MAX, -1 if unknown;
+ filled once by probe_capacity()
+ */
+static int capacity[CPU_SETSIZE];
+static int capacity_probed;
+
+
+/*
+ parse the kernel's cpulist format, e.g. "0-3,8,10-11"; an empty string
+ (or just a newline) is a valid, empty list
+ */
+int parse_cpulist(const char *str, cpu_set_t *mask)
+{
+	CPU_ZERO(mask);
+
+	while(*str && *str != '\n') {
+		unsigned long first, last;
+		char *end;
+
+		if(! isdigit((int)*str)) {
+			return(-1);
+		}
+		first=last=strtoul(str, &end, 10);
+
+		if(*end == '-') {
+			str=end+1;
+			if(! isdigit((int)*str)) {
+				return(-1);
+			}
+			last=strtoul(str, &end, 10);
+		}
+
+		if(first > last || last >= CPU_SETSIZE) {
+			return(-1);
+		}
+		for(; first <= last; first++) {
+			CPU_SET(first, mask);
+		}
+
+		str=end;
+		if(*str == ',') {
+			str++;
+		} else if(*str && *str != '\n') {
+			return(-1);
+		}
+	}
+	return(0);
+}
+
+
+/* a missing file is an error, an empty one an empty list */
+int read_cpulist(const char *path, cpu_set_t *mask)
+{
+	FILE *f;
+	char buf[4096];
+	int ret=0;
+
+	CPU_ZERO(mask);
+
+	if(! (f=fopen(path, "r"))) {
+		return(-1);
+	}
+	if(fgets(buf, sizeof(buf), f)) {
+		ret=parse_cpulist(buf, mask);
+	}
+	fclose(f);
+	return(ret);
+}
+
+
+/* CPUs of isolcpus= and nohz_full=; both mean "keep the kernel off here" */
+void get_isolated_cpus(cpu_set_t *mask)
+{
+	cpu_set_t nohz;
+
+	read_cpulist(SYSFS_CPU "/isolated", mask);
+	if(! read_cpulist(SYSFS_CPU "/nohz_full", &nohz)) {
+		CPU_OR(mask, mask, &nohz);
+	}
+}
+
+
+void get_online_cpus(cpu_set_t *mask)
+{
+	int cpu;
+
+	if(read_cpulist(SYSFS_CPU "/online", mask)) {
+		/* no sysfs - trust sysconf() */
+		CPU_ZERO(mask);
+		for(cpu=0; cpu < sysconf(_SC_NPROCESSORS_ONLN) && cpu < CPU_SETSIZE; cpu++) {
+			CPU_SET(cpu, mask);
+		}
+	}
+}
+
+
+static long read_long(const char *path)
+{
+	FILE *f;
+	long val=-1;
+
+	if((f=fopen(path, "r"))) {
+		if(fscanf(f, "%ld", &val) != 1) {
+			val=-1;
+		}
+		fclose(f);
+	}
+	return(val);
+}
+
+
+/*
+ cpu_capacity is what the scheduler itself uses (arm, newer x86); without
+ it, the maximum frequency from cpufreq relative to the fastest CPU is the
+ next best thing
+ */
+static void probe_capacity(void)
+{
+	char path[128];
+	long freq[CPU_SETSIZE];
+	long max_freq=0;
+	int cpu, have_capacity=0;
+	cpu_set_t online;
+
+	capacity_probed=1;
+	get_online_cpus(&online);
+
+	for(cpu=0; cpu < CPU_SETSIZE; cpu++) {
+		capacity[cpu]=-1;
+		freq[cpu]=-1;
+
+		if(! CPU_ISSET(cpu, &online)) {
+			continue;
+		}
+
+		snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/cpu_capacity", cpu);
+		if((capacity[cpu]=read_long(path)) >= 0) {
+			have_capacity=1;
+			continue;
+		}
+
+		snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/cpufreq/cpuinfo_max_freq", cpu);
+		if((freq[cpu]=read_long(path)) > max_freq) {
+			max_freq=freq[cpu];
+		}
+	}
+
+	if(have_capacity || ! max_freq) {
+		return;
+	}
+	for(cpu=0; cpu < CPU_SETSIZE; cpu++) {
+		if(freq[cpu] > 0) {
+			capacity[cpu]=freq[cpu] * CPU_CAPACITY_MAX / max_freq;
+		}
+	}
+}
+
+
+/* all online CPUs with at least min_capacity; -1 if capacities are unknown */
+static int get_capacity_cpus(int min_capacity, cpu_set_t *mask)
+{
+	int cpu, known=0;
+
+	if(! capacity_probed) {
+		probe_capacity();
+	}
+
+	CPU_ZERO(mask);
+	for(cpu=0; cpu < CPU_SETSIZE; cpu++) {
+		if(capacity[cpu] < 0) {
+			continue;
+		}
+		known=1;
+		if(capacity[cpu] >= min_capacity) {
+			CPU_SET(cpu, mask);
+		}
+	}
+	return(known ? 0 : -1);
+}
+
+
+/*
+ split CPUs by capacity (-1 for unknown ones) into performance and
+ efficiency cores. Only CPUs more than CORE_TYPE_GAP percent below the
+ biggest capacity are efficiency cores, so the favoured cores of Turbo
+ Boost Max 3.0, which reach a slightly higher frequency, don't turn all
+ others into E-cores. Returns -1 if there are no efficiency cores.
+ */
+int split_core_types(const int *cap, int n, cpu_set_t *pcores, cpu_set_t *ecores)
+{
+	int cpu, max=-1;
+
+	CPU_ZERO(pcores);
+	CPU_ZERO(ecores);
+
+	for(cpu=0; cpu < n; cpu++) {
+		if(cap[cpu] > max) {
+			max=cap[cpu];
+		}
+	}
+	if(max <= 0) {
+		return(-1);
+	}
+
+	for(cpu=0; cpu < n; cpu++) {
+		if(cap[cpu] < 0) {
+			continue;
+		}
+		if(cap[cpu] * 100L >= max * (100L - CORE_TYPE_GAP)) {
+			CPU_SET(cpu, pcores);
+		} else {
+			CPU_SET(cpu, ecores);
+		}
+	}
+	return(CPU_COUNT(ecores) ? 0 : -1);
+}
+
+
+/*
+ split the online CPUs into performance and efficiency cores: the PMU
+ devices of Intel hybrid CPUs tell directly, otherwise their capacities
+ do, see split_core_types(). Returns -1 if the CPU isn't hybrid (or we
+ can't tell).
+ */
+int get_core_types(cpu_set_t *pcores, cpu_set_t *ecores)
+{
+	/* query mode asks for every PID, so only look once */
+	static int probed, ret;
+	static cpu_set_t p, e;
+
+	if(probed) {
+		goto out;
+	}
+	probed=1;
+	ret=-1;
+
+	if(! read_cpulist(SYSFS_PCORES, &p) && ! read_cpulist(SYSFS_ECORES, &e)) {
+		ret=(CPU_COUNT(&e) ? 0 : -1);
+		goto out;
+	}
+
+	if(! capacity_probed) {
+		probe_capacity();
+	}
+	ret=split_core_types(capacity, CPU_SETSIZE, &p, &e);
+
+out:
+	*pcores=p;
+	*ecores=e;
+	return(ret);
+}
+
+
+/* format mask as cpulist, e.g. "0-3,8"; "" if empty */
+char * cpuset_to_cpulist(cpu_set_t *mask, char *str, size_t len)
+{
+	int cpu, last;
+	size_t pos=0;
+
+	*str=0;
+	for(cpu=0; cpu < CPU_SETSIZE; cpu++) {
+		if(! CPU_ISSET(cpu, mask)) {
+			continue;
+		}
+		for(last=cpu; last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, mask); last++)
+			;
+
+		if(pos < len) {
+			pos += snprintf(str + pos, len - pos, (last == cpu ? "%s%d" : "%s%d-%d"),
+					(pos ? "," : ""), cpu, last);
+		}
+		cpu=last;
+	}
+	return(str);
+}
+
+
+/*
+ resolve a symbolic affinity; returns -1 for unknown tokens
+	isolated	isolcpus=
+	nohz_full	nohz_full=
+	housekeeping	online CPUs which are neither of the above
+	online		all online CPUs
+	pcore, ecore	performance/efficiency cores of hybrid CPUs
+	capacity>=N	CPUs with at least capacity N of CPU_CAPACITY_MAX
+ */
+int cpu_token(const char *token, cpu_set_t *mask)
+{
+	cpu_set_t tmp;
+
+	if(! strcmp(token, "isolated")) {
+		read_cpulist(SYSFS_CPU "/isolated", mask);
+
+	} else if(! strcmp(token, "nohz_full")) {
+		read_cpulist(SYSFS_CPU "/nohz_full", mask);
+
+	} else if(! strcmp(token, "housekeeping")) {
+		get_online_cpus(mask);
+		get_isolated_cpus(&tmp);
+		CPU_XOR(&tmp, &tmp, mask);
+		CPU_AND(mask, mask, &tmp);
+
+	} else if(! strcmp(token, "online")) {
+		get_online_cpus(mask);
+
+	} else if(! strcmp(token, "pcore") || ! strcmp(token, "ecore")) {
+		if(get_core_types(mask, &tmp)) {
+			errno=0;
+			decode_error("no hybrid CPU detected for %s", token);
+			return(-1);
+		}
+		if(! strcmp(token, "ecore")) {
+			*mask=tmp;
+		}
+
+	} else if(! strncmp(token, "capacity>=", 10)) {
+		char *end;
+		long min=strtol(token + 10, &end, 10);
+
+		if(end == token + 10 || *end) {
+			return(-1);
+		}
+		if(get_capacity_cpus(min, mask)) {
+			errno=0;
+			decode_error("CPU capacities are not known for %s", token);
+			return(-1);
+		}
+
+	} else {
+		return(-1);
+	}
+	return(0);
+}
+
+
+/*
+ the CPUs the cpuset cgroup of pid allows; cgroup v1 cpuset controller
+ first, then the v2 hierarchy, walking up to the first cgroup having the
+ cpuset controller enabled. Returns -1 if it can't be determined.
+ */
+int task_cpuset(pid_t pid, cpu_set_t *mask)
+{
+	FILE *f;
+	char buf[4096], path[4096 + 64];
+	char *v1=NULL, *v2=NULL;
+	int ret=-1;
+
+	snprintf(path, sizeof(path), "/proc/%d/cgroup", pid);
+	if(! (f=fopen(path, "r"))) {
+		return(-1);
+	}
+
+	while(fgets(buf, sizeof(buf), f)) {
+		char *ctrl, *cgpath;
+
+		buf[strcspn(buf, "\n")]=0;
+
+		/* hierarchy-ID:controller-list:cgroup-path */
+		if(! (ctrl=strchr(buf, ':')) || ! (cgpath=strchr(++ctrl, ':'))) {
+			continue;
+		}
+		*cgpath++=0;
+
+		if(! *ctrl) {
+			free(v2);
+			v2=strdup(cgpath);
+		} else {
+			char *c, *list=ctrl;
+
+			while((c=strsep(&list, ","))) {
+				if(! strcmp(c, "cpuset")) {
+					free(v1);
+					v1=strdup(cgpath);
+				}
+			}
+		}
+	}
+	fclose(f);
+
+	if(v1) {
+		snprintf(path, sizeof(path), SYSFS_CGROUP "/cpuset%s/cpuset.effective_cpus", v1);
+		ret=read_cpulist(path, mask);
+		if(ret) {
+			snprintf(path, sizeof(path), SYSFS_CGROUP "/cpuset%s/cpuset.cpus", v1);
+			ret=read_cpulist(path, mask);
+		}
+
+	} else if(v2) {
+		char *slash;
+
+		for(;;) {
+			snprintf(path, sizeof(path), SYSFS_CGROUP "%s/cpuset.cpus.effective",
+				 strcmp(v2, "/") ? v2 : "");
+			if(! (ret=read_cpulist(path, mask)) || ! (slash=strrchr(v2, '/'))
+			   || slash == v2) {
+				break;
+			}
+			*slash=0;
+		}
+		if(ret) {
+			ret=read_cpulist(SYSFS_CGROUP "/cpuset.cpus.effective", mask);
+		}
+	}
+
+	free(v1);
+	free(v2);
+
+	/* a task can't live in an empty cpuset, so we read something wrong */
+	if(! ret && ! CPU_COUNT(mask)) {
+		ret=-1;
+	}
+	return(ret);
+}
@@ -0,0 +1,37 @@
+/*
+ Schedtool
+ (c) by Freek <email_undisclosed>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation version 2 of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ Please see the file LICENSE for details.
+
+ */
+
+#define SYSFS_CPU	"/sys/devices/system/cpu"
+#define SYSFS_CGROUP	"/sys/fs/cgroup"
+/* PMU devices of Intel hybrid CPUs */
+#define SYSFS_PCORES	"/sys/devices/cpu_core/cpus"
+#define SYSFS_ECORES	"/sys/devices/cpu_atom/cpus"
+
+/* what the kernel uses as capacity of the biggest CPU */
+#define CPU_CAPACITY_MAX	1024
+/* % below the biggest capacity from which on a CPU is an efficiency core */
+#define CORE_TYPE_GAP	20
+
+int parse_cpulist(const char *str, cpu_set_t *mask);
+int read_cpulist(const char *path, cpu_set_t *mask);
+int cpu_token(const char *token, cpu_set_t *mask);
+void get_isolated_cpus(cpu_set_t *mask);
+void get_online_cpus(cpu_set_t *mask);
+int task_cpuset(pid_t pid, cpu_set_t *mask);
+int get_core_types(cpu_set_t *pcores, cpu_set_t *ecores);
+int split_core_types(const int *cap, int n, cpu_set_t *pcores, cpu_set_t *ecores);
+char * cpuset_to_cpulist(cpu_set_t *mask, char *str, size_t len);
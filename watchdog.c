@@ -0,0 +1,413 @@
+/*
+ Schedtool
+ (c) by Freek <email_undisclosed>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation version 2 of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ Please see the file LICENSE for details.
+
+ */
+
+/*
+ Content:
+
+ watchdog for real-time runaways. A spinning SCHED_FIFO/RR thread makes
+ the kernel's RT throttling kick in, which hurts all RT tasks on the box.
+ Every window we sample the runtime of all RT and deadline threads (of
+ the given PIDs, or of the whole system) and demote those which used
+ more than their budget to SCHED_NORMAL/BATCH. After a cool-down they
+ may get their old policy back.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sched.h>
+
+#include "error.h"
+#include "schedtool.h"
+#include "taskstat.h"
+#include "watchdog.h"
+
+struct wd_task_s {
+	pid_t pid;
+	pid_t tid;
+	int policy;
+	int prio;
+	struct schedstat_s stat;
+	/* demoted at now_ms(), 0 if not */
+	unsigned long long demoted;
+};
+
+/* what we sampled in the last window, sorted by tid */
+static struct wd_task_s *tasks;
+static int n_tasks;
+
+/* demoted tasks waiting to be promoted again */
+static struct wd_task_s *demoted;
+static int n_demoted;
+
+
+/*
+ -w PERCENT[,window=MS][,demote=normal|batch][,cooldown=MS][,count=N]
+ a bare number is the budget in percent of one CPU
+ */
+int watchdog_opts(char *opts, struct watchdog_s *w)
+{
+	char *tokens[] = { "budget", "window", "demote", "cooldown", "count", NULL };
+	char *val, *end;
+	long l=0;
+	int i;
+
+	w->budget=950;
+	w->window=1000;
+	w->demote=SCHED_NORMAL;
+	w->cooldown=0;
+	w->count=0;
+
+	while(*opts) {
+		if((i=getsubopt(&opts, tokens, &val)) < 0 && val && isdigit((int)*val)) {
+			i=0;
+		} else if(i < 0 || ! val) {
+			errno=0;
+			decode_error("unknown or incomplete watchdog option %s", val ? val : "");
+			return(-1);
+		}
+
+		if(i == 2) {
+			if(! strcasecmp(val, "normal") || ! strcasecmp(val, "other")) {
+				w->demote=SCHED_NORMAL;
+			} else if(! strcasecmp(val, "batch")) {
+				w->demote=SCHED_BATCH;
+			} else {
+				errno=0;
+				decode_error("can only demote to normal or batch, not %s", val);
+				return(-1);
+			}
+			continue;
+		}
+
+		l=strtol(val, &end, 10);
+		if(end == val || *end || l < 0 || (i == 0 && (l == 0 || l > 100))
+		   || (i == 1 && l == 0)) {
+			errno=0;
+			decode_error("invalid value %s for %s", val, tokens[i]);
+			return(-1);
+		}
+
+		switch(i) {
+		case 0: w->budget=l * 10; break;
+		case 1: w->window=l; break;
+		case 3: w->cooldown=l; break;
+		case 4: w->count=l; break;
+		}
+	}
+	return(0);
+}
+
+
+static struct wd_task_s * find_task(struct wd_task_s *t, int n, pid_t tid)
+{
+	int lo=0, hi=n-1;
+
+	while(lo <= hi) {
+		int mid=(lo + hi) / 2;
+
+		if(t[mid].tid == tid) {
+			return(&t[mid]);
+		}
+		if(t[mid].tid < tid) {
+			lo=mid+1;
+		} else {
+			hi=mid-1;
+		}
+	}
+	return(NULL);
+}
+
+
+static int cmp_task(const void *a, const void *b)
+{
+	return(((const struct wd_task_s *)a)->tid - ((const struct wd_task_s *)b)->tid);
+}
+
+
+static int add_task(struct wd_task_s **t, int *n, int *size, struct wd_task_s *task)
+{
+	struct wd_task_s *tmp;
+
+	if(*n == *size) {
+		*size=(*size ? *size * 2 : 64);
+		if(! (tmp=realloc(*t, *size * sizeof(**t)))) {
+			return(-1);
+		}
+		*t=tmp;
+	}
+	(*t)[(*n)++]=*task;
+	return(0);
+}
+
+
+/* add all RT/deadline threads of pid to *t */
+static void sample_pid(pid_t pid, struct wd_task_s **t, int *n, int *size)
+{
+	pid_t *tids;
+	int i, n_tids;
+
+	if((n_tids=get_threads(pid, &tids)) < 0) {
+		return;
+	}
+
+	for(i=0; i < n_tids; i++) {
+		struct wd_task_s task;
+		struct sched_param p;
+
+		memset(&task, 0, sizeof(task));
+		task.pid=pid;
+		task.tid=tids[i];
+
+		if((task.policy=sched_getscheduler(tids[i])) < 0) {
+			continue;
+		}
+		task.policy &= ~SCHED_RESET_ON_FORK;
+		if(! IS_RT_POLICY(task.policy)) {
+			continue;
+		}
+		if(sched_getparam(tids[i], &p) == 0) {
+			task.prio=p.sched_priority;
+		}
+		if(read_schedstat(pid, tids[i], &(task.stat))) {
+			continue;
+		}
+		add_task(t, n, size, &task);
+	}
+	free(tids);
+}
+
+
+/* all RT/deadline threads of pids, or of all processes if n == 0 */
+static int sample_tasks(pid_t *pids, int n, struct wd_task_s **t)
+{
+	int i, count=0, size=0;
+
+	*t=NULL;
+
+	if(n) {
+		for(i=0; i < n; i++) {
+			sample_pid(pids[i], t, &count, &size);
+		}
+	} else {
+		DIR *dir;
+		struct dirent *d;
+
+		if(! (dir=opendir("/proc"))) {
+			decode_error("could not read /proc");
+			return(-1);
+		}
+		/* kernel threads are none of our business, migration/N & co. run RT anyway */
+		while((d=readdir(dir))) {
+			if(isdigit((int)*(d->d_name)) && ! is_kernel_thread(atoi(d->d_name))) {
+				sample_pid(atoi(d->d_name), t, &count, &size);
+			}
+		}
+		closedir(dir);
+	}
+
+	if(count) {
+		qsort(*t, count, sizeof(**t), cmp_task);
+	}
+	return(count);
+}
+
+
+static char * policy_name(int policy, char *buf, size_t len)
+{
+	if(CHECK_RANGE_POLICY(policy)) {
+		snprintf(buf, len, "%s", TAB[policy]);
+	} else if(policy == SCHED_DEADLINE) {
+		snprintf(buf, len, "SCHED_DEADLINE");
+	} else {
+		snprintf(buf, len, "raw policy #%d", policy);
+	}
+	return(buf);
+}
+
+
+/* demote everything above budget; returns the # of failed demotions */
+static int check_budgets(struct watchdog_s *w, struct wd_task_s *t, int n,
+			 unsigned long long elapsed)
+{
+	int i, failed=0;
+
+	for(i=0; i < n; i++) {
+		struct wd_task_s *prev;
+		unsigned long long usage;
+		char comm[32], from[32], to[32];
+
+		/* new in this window, no delta yet */
+		if(! (prev=find_task(tasks, n_tasks, t[i].tid))) {
+			continue;
+		}
+
+		usage=(t[i].stat.run - prev->stat.run) * 1000 / (elapsed * 1000000ULL);
+		if(usage <= (unsigned long long)w->budget) {
+			continue;
+		}
+
+		printf("DEMOTE: PID %d TID %d (%s) used %llu.%llu%% CPU in %llums, budget %d%%:"
+		       " %s PRIO %d -> %s%s\n",
+		       t[i].pid,
+		       t[i].tid,
+		       get_comm(t[i].pid, t[i].tid, comm, sizeof(comm)),
+		       usage / 10, usage % 10,
+		       elapsed,
+		       w->budget / 10,
+		       policy_name(t[i].policy, from, sizeof(from)),
+		       t[i].prio,
+		       policy_name(w->demote, to, sizeof(to)),
+		       (w->dryrun ? " (dry run)" : "")
+		      );
+		fflush(stdout);
+
+		if(w->dryrun) {
+			continue;
+		}
+		if(set_process(t[i].tid, w->demote, 0, 0)) {
+			failed++;
+			continue;
+		}
+
+		if(w->cooldown) {
+			int size=n_demoted;
+
+			t[i].demoted=now_ms();
+			add_task(&demoted, &n_demoted, &size, &t[i]);
+		}
+	}
+	return(failed);
+}
+
+
+/* give tasks their policy back once the cool-down is over */
+static void check_cooldowns(struct watchdog_s *w)
+{
+	unsigned long long now=now_ms();
+	int i, j;
+
+	for(i=0, j=0; i < n_demoted; i++) {
+		struct wd_task_s *d=&demoted[i];
+		char comm[32], to[32];
+		int policy;
+
+		if(now - d->demoted < (unsigned long long)w->cooldown) {
+			demoted[j++]=*d;
+			continue;
+		}
+
+		/* gone, or someone else changed it meanwhile - not ours anymore */
+		if((policy=sched_getscheduler(d->tid)) < 0
+		   || (policy & ~SCHED_RESET_ON_FORK) != w->demote) {
+			continue;
+		}
+
+		get_comm(d->pid, d->tid, comm, sizeof(comm));
+		policy_name(d->policy, to, sizeof(to));
+
+		if(d->policy == SCHED_DEADLINE) {
+			printf("PROMOTE: PID %d TID %d (%s) can't be given %s back, stays demoted\n",
+			       d->pid, d->tid, comm, to);
+		} else if(! set_process(d->tid, d->policy, d->prio, 0)) {
+			printf("PROMOTE: PID %d TID %d (%s) back to %s PRIO %d after %llums\n",
+			       d->pid, d->tid, comm, to, d->prio, now - d->demoted);
+		}
+		fflush(stdout);
+	}
+	n_demoted=j;
+}
+
+
+/* on exit, tell which tasks stay demoted as their cool-down isn't over */
+static void report_demoted(struct watchdog_s *w)
+{
+	int i, policy;
+
+	for(i=0; i < n_demoted; i++) {
+		struct wd_task_s *d=&demoted[i];
+		char comm[32], to[32];
+
+		/* as in check_cooldowns(): gone or changed, not ours anymore */
+		if((policy=sched_getscheduler(d->tid)) < 0
+		   || (policy & ~SCHED_RESET_ON_FORK) != w->demote) {
+			continue;
+		}
+		printf("PROMOTE: PID %d TID %d (%s) stays demoted, no %s back before exit\n",
+		       d->pid, d->tid,
+		       get_comm(d->pid, d->tid, comm, sizeof(comm)),
+		       policy_name(d->policy, to, sizeof(to)));
+	}
+	fflush(stdout);
+}
+
+
+/*
+ run until interrupted or w->count windows have passed; returns the # of
+ failed demotions, -1 if it could not even start
+ */
+int watchdog(struct watchdog_s *w, pid_t *pids, int n)
+{
+	struct wd_task_s *t;
+	unsigned long long last, now;
+	long window;
+	int count, failed=0;
+
+	catch_stop_signals();
+
+	if((n_tasks=sample_tasks(pids, n, &tasks)) < 0) {
+		return(-1);
+	}
+	last=now_ms();
+
+	for(window=1; ! stop_requested() && (! w->count || window <= w->count); window++) {
+		sleep_ms(w->window);
+		if(stop_requested()) {
+			break;
+		}
+
+		now=now_ms();
+		if((count=sample_tasks(pids, n, &t)) < 0) {
+			break;
+		}
+
+		/* the windows are as long as they really were, not as requested */
+		failed += check_budgets(w, t, count, (now > last ? now - last : 1));
+		check_cooldowns(w);
+
+		if(w->verbose) {
+			printf("WATCHDOG: window %ld, %d RT tasks, %d demoted\n",
+			       window, count, n_demoted);
+			fflush(stdout);
+		}
+
+		free(tasks);
+		tasks=t;
+		n_tasks=count;
+		last=now;
+	}
+
+	report_demoted(w);
+	free(tasks);
+	free(demoted);
+	return(failed);
+}
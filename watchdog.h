@@ -0,0 +1,36 @@
+/*
+ Schedtool
+ (c) by Freek <email_undisclosed>
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation version 2 of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ Please see the file LICENSE for details.
+
+ */
+
+/* parameters of -w, see watchdog_opts() for the defaults */
+struct watchdog_s {
+	/* max CPU usage per window, in per-mille of one CPU */
+	int budget;
+	/* window length in ms */
+	long window;
+	/* policy runaways are demoted to */
+	int demote;
+	/* ms after which a demoted task gets its policy back, 0 for never */
+	long cooldown;
+	/* stop after that many windows, 0 for never */
+	long count;
+
+	int dryrun;
+	int verbose;
+};
+
+int watchdog_opts(char *opts, struct watchdog_s *w);
+int watchdog(struct watchdog_s *w, pid_t *pids, int n);